@@ -0,0 +1,192 @@
+#include "block_cache.h"
+#include "threaded.h"
+#include "jit.h"
+#include "mmu.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define BLOCK_HASH(pc) (((pc) >> 1) & (BLOCK_HASH_SIZE - 1))
+#define LINK_REG(r) ((r) == 1 || (r) == 5) // ra, t0: return address hints
+
+block_cache_t* block_cache_create(void) {
+    block_cache_t* cache = calloc(1, sizeof(block_cache_t));
+    if (!cache) return NULL;
+    cache->blocks = malloc(BLOCK_CACHE_BLOCKS * sizeof(block_t));
+    cache->ops = malloc(BLOCK_CACHE_OPS * sizeof(predecoded_t));
+    if (!cache->blocks || !cache->ops) {
+        block_cache_destroy(cache);
+        return NULL;
+    }
+    cache->fusion = 1;
+#if JIT_CODE
+    cache->jit = jit_create(); // Without it blocks are only interpreted
+#endif
+    return cache;
+}
+
+void block_cache_destroy(block_cache_t* cache) {
+    if (!cache) return;
+#if JIT_CODE
+    jit_destroy(cache->jit);
+#endif
+    free(cache->blocks);
+    free(cache->ops);
+    free(cache);
+}
+
+int block_ends_with(uint32_t inst_type) {
+    return (inst_type >= INST_BEQ && inst_type <= INST_JALR) ||
+           (inst_type >= INST_FENCE && inst_type <= INST_CSRRCI) ||
+           inst_type == INST_UNKNOWN;
+}
+
+static void block_cache_reset(block_cache_t* cache) {
+    memset(cache->hash, 0, sizeof(cache->hash));
+    cache->num_blocks = 0;
+    cache->num_ops = 0;
+    cache->ras_depth = 0;
+    cache->flush_pending = 0;
+    cache->flushes++;
+#if JIT_CODE
+    if (cache->jit) jit_reset(cache->jit);
+#endif
+}
+
+void block_cache_flush(block_cache_t* cache) {
+    cache->flush_pending = 1;
+}
+
+void block_cache_sync(block_cache_t* cache) {
+    if (cache->flush_pending) block_cache_reset(cache);
+}
+
+block_t* block_cache_build(block_cache_t* cache, cpu_t* cpu, memory_t* memory, reg_t pc) {
+    if (cache->num_blocks == BLOCK_CACHE_BLOCKS || cache->num_ops + BLOCK_MAX_OPS > BLOCK_CACHE_OPS) {
+        block_cache_reset(cache);
+    }
+    
+    block_t* block = &cache->blocks[cache->num_blocks];
+    predecoded_t* ops = &cache->ops[cache->num_ops];
+    reg_t page = pc >> ICACHE_PAGE_SHIFT;
+    reg_t cur = pc;
+    uint32_t count = 0;
+    
+    while (count < BLOCK_MAX_OPS) {
+        predecoded_t* entry = icache_lookup(cpu->icache, cpu, memory, cur);
+        if (!entry) break; // Fetch fault is reported when execution gets there
+        ops[count++] = *entry;
+        cur += entry->length;
+        if (block_ends_with(entry->inst_type)) break;
+        if ((cur >> ICACHE_PAGE_SHIFT) != page) break;
+    }
+    if (count == 0) return NULL;
+    if (cache->fusion) fuse_block(ops, count, cache->fused);
+    
+    // Frames the code came from; only the last op can reach into a second one.
+    // The fetches above succeeded, so neither translation can fault.
+    uint64_t phys;
+    mmu_translate(cpu, memory, pc, MMU_FETCH, &phys);
+    block->frames[0] = phys >> ICACHE_PAGE_SHIFT;
+    mmu_translate(cpu, memory, cur - 1, MMU_FETCH, &phys);
+    block->frames[1] = phys >> ICACHE_PAGE_SHIFT;
+#if THREADED_CODE
+    for (uint32_t i = 0; i < count; i++) {
+        ops[i].variant = threaded_variant(&ops[i], i == count - 1);
+    }
+#endif
+    
+    predecoded_t* last = &ops[count - 1];
+    block->pc = pc;
+    block->end_pc = cur;
+    block->next_pc[0] = cur;
+    block->next_pc[1] = cur;
+    block->kind = 0;
+    if ((last->inst_type >= INST_BEQ && last->inst_type <= INST_BGEU) ||
+        last->inst_type == INST_JAL) {
+        block->next_pc[1] = (cur - last->length) + (sreg_t)last->imm;
+    } else if (count >= 2 && ops[count - 2].inst_type == INST_FUSED_CALL) {
+        // auipc+jalr has a static target, so calls can be chained too
+        const predecoded_t* call = &ops[count - 2];
+        reg_t call_pc = cur - last->length - call->length;
+        block->next_pc[1] = (call_pc + (sreg_t)call->imm + (sreg_t)last->imm) & ~(reg_t)1;
+    } else if (last->inst_type == INST_JALR) {
+        block->kind = BLOCK_INDIRECT;
+    }
+    
+    // Call/return hints as in the JALR spec: a link rd pushes, a link rs1
+    // pops unless it is also rd
+    uint32_t rd = last->rd;
+    uint32_t rs1 = last->rs1;
+    if (last->inst_type == INST_JAL || last->inst_type == INST_JALR) {
+        if (LINK_REG(rd)) block->kind |= BLOCK_CALL;
+        if (last->inst_type == INST_JALR && LINK_REG(rs1) && rs1 != rd) block->kind |= BLOCK_RETURN;
+    }
+    block->next[0] = NULL;
+    block->next[1] = NULL;
+    block->ops = ops;
+    block->count = count;
+    block->space = cache->space;
+    block->valid = 1;
+#if JIT_CODE
+    block->hits = 0;
+    block->jit_code = NULL;
+#endif
+    block->hash_next = cache->hash[BLOCK_HASH(pc)];
+    cache->hash[BLOCK_HASH(pc)] = block;
+    
+    cache->num_blocks++;
+    cache->num_ops += count;
+    cache->built++;
+    return block;
+}
+
+block_t* block_cache_find(block_cache_t* cache, reg_t pc) {
+    for (block_t* block = cache->hash[BLOCK_HASH(pc)]; block; block = block->hash_next) {
+        if (block->pc == pc && block->space == cache->space) return block;
+    }
+    return NULL;
+}
+
+block_t* block_cache_lookup(block_cache_t* cache, cpu_t* cpu, memory_t* memory, reg_t pc) {
+    block_t* block = block_cache_find(cache, pc);
+    return block ? block : block_cache_build(cache, cpu, memory, pc);
+}
+
+uint32_t block_cache_heat(block_cache_t* cache, reg_t pc) {
+    uint8_t* heat = &cache->heat[BLOCK_HASH(pc)];
+    if (*heat < UINT8_MAX) (*heat)++;
+    return *heat;
+}
+
+// Unhash a block; chain links into it are dropped lazily via the valid flag
+static void block_cache_drop(block_cache_t* cache, block_t* block) {
+    block_t** link = &cache->hash[BLOCK_HASH(block->pc)];
+    while (*link != block) link = &(*link)->hash_next;
+    *link = block->hash_next;
+    block->valid = 0;
+#if JIT_CODE
+    jit_invalidate(block);
+#endif
+}
+
+void block_cache_code_write(block_cache_t* cache, uint64_t address) {
+    uint64_t frame = address >> ICACHE_PAGE_SHIFT;
+    
+    for (uint32_t i = 0; i < cache->num_blocks; i++) {
+        block_t* block = &cache->blocks[i];
+        if (block->valid && (block->frames[0] == frame || block->frames[1] == frame)) {
+            block_cache_drop(cache, block);
+        }
+    }
+}
+
+void block_cache_unmap(block_cache_t* cache, reg_t address) {
+    reg_t page = address >> ICACHE_PAGE_SHIFT;
+    
+    for (uint32_t i = 0; i < cache->num_blocks; i++) {
+        block_t* block = &cache->blocks[i];
+        if (!block->valid || !block->space) continue;
+        if ((block->pc >> ICACHE_PAGE_SHIFT) > page || ((block->end_pc - 1) >> ICACHE_PAGE_SHIFT) < page) continue;
+        block_cache_drop(cache, block);
+    }
+}
@@ -0,0 +1,117 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cpu.h"
+#include "icache.h"
+#include "fusion.h"
+
+#define BLOCK_MAX_OPS 64          // Longest straight-line run in one block
+#define BLOCK_CACHE_BLOCKS 16384  // Arena capacity; a full arena is flushed
+#define BLOCK_CACHE_OPS (BLOCK_CACHE_BLOCKS * 8)
+#define BLOCK_HASH_SIZE 4096
+#define BLOCK_RAS_SIZE 32         // Shadow return-address stack depth
+
+// How the last op leaves a block (block_t.kind)
+#define BLOCK_CALL     0x01       // Links ra/t0: pushes the block on the return stack
+#define BLOCK_RETURN   0x02       // Jumps through ra/t0: pops the return stack
+#define BLOCK_INDIRECT 0x04       // JALR: next_pc[1]/next[1] cache the last target
+
+// Basic block: predecoded ops ending at a branch, jump, system instruction
+// or page boundary. Successor links are patched in as edges are taken.
+// Fused ops keep their second op in place, so count is still instructions.
+typedef struct block {
+    reg_t pc;                   // Guest address of the first op
+    reg_t end_pc;               // Address after the last op (fallthrough)
+    reg_t next_pc[2];           // [0] fallthrough, [1] direct target or last indirect target
+    struct block* next[2];      // Chained successors for next_pc[]
+    struct block* hash_next;
+    predecoded_t* ops;          // count ops in the arena; ops[count - 1] may redirect
+    uint32_t count;
+    uint32_t space;             // Fetched through translation (block_cache_t.space)
+    uint64_t frames[2];         // Physical page numbers of the first op and the last op's end
+    uint32_t valid;             // Cleared when a store hits the block's code
+    uint32_t kind;              // BLOCK_CALL/RETURN/INDIRECT flags
+#if JIT_CODE
+    uint32_t hits;              // Entries from the run loop while untranslated
+    const void* jit_code;       // Translated entry point, NULL until hot
+    const void* jit_bail;       // Exit taken on entry once the block is invalid
+    uint8_t* jit_exit[2];       // rel32 of the direct jump for next_pc[] exits
+    uint8_t* jit_target;        // imm64 compared against the pc on an indirect exit
+    struct block* jit_linked[2]; // Block each exit jump currently targets
+#endif
+} block_t;
+
+typedef struct block_cache {
+    block_t* hash[BLOCK_HASH_SIZE];
+    uint8_t heat[BLOCK_HASH_SIZE]; // Leader visits while unbuilt, direct-mapped by pc
+    block_t* blocks;            // Block arena
+    predecoded_t* ops;          // Op arena
+    struct jit* jit;            // Translated code for the arena's blocks (JIT builds)
+    block_t* ras[BLOCK_RAS_SIZE]; // Call blocks; a return lands on their next[0]
+    uint32_t ras_top;
+    uint32_t ras_depth;
+    uint32_t num_blocks;
+    uint32_t num_ops;
+    int flush_pending;          // Reset the arena at the next block boundary
+    int fusion;                 // Fuse common instruction pairs while building
+    uint32_t space;             // Blocks found/built are virtual (1) or physical (0); set by the run loop
+    uint64_t built;
+    uint64_t chained;           // Block transitions that followed a chain link
+    uint64_t ras_hits;          // Returns resolved through the return stack
+    uint64_t ic_hits;           // Indirect jumps that matched their cached target
+    uint64_t ic_misses;         // ... and that replaced it
+    uint64_t flushes;
+    uint64_t fused[FUSION_KINDS];       // Pairs fused while building, per kind
+    uint64_t fusion_hits[FUSION_KINDS]; // Fused ops executed, per kind
+    block_t* running;           // Block executing when an access faults; NULL while interpreting
+    uint64_t running_instret;   // cpu->instret when it was entered
+} block_cache_t;
+
+block_cache_t* block_cache_create(void);
+void block_cache_destroy(block_cache_t* cache);
+
+// Block starting at pc, built from cpu's predecode cache on a miss; NULL if pc
+// cannot be fetched
+block_t* block_cache_lookup(block_cache_t* cache, cpu_t* cpu, memory_t* memory, reg_t pc);
+
+// Block starting at pc in the current space if one has been built, else NULL
+block_t* block_cache_find(block_cache_t* cache, reg_t pc);
+
+// Build the block starting at pc (not already cached); NULL if pc cannot be fetched
+block_t* block_cache_build(block_cache_t* cache, cpu_t* cpu, memory_t* memory, reg_t pc);
+
+// Count a visit to the leader at pc; returns visits so far (saturating)
+uint32_t block_cache_heat(block_cache_t* cache, reg_t pc);
+
+// Whether an instruction must be the last op of a block
+int block_ends_with(uint32_t inst_type);
+
+// Drop every block at the next block boundary (FENCE.I)
+void block_cache_flush(block_cache_t* cache);
+// Apply a pending flush; call only between blocks
+void block_cache_sync(block_cache_t* cache);
+
+// Return stack; it wraps around when full and is emptied with the arena
+static inline void block_cache_push_call(block_cache_t* cache, block_t* call) {
+    cache->ras_top = (cache->ras_top + 1) & (BLOCK_RAS_SIZE - 1);
+    cache->ras[cache->ras_top] = call;
+    if (cache->ras_depth < BLOCK_RAS_SIZE) cache->ras_depth++;
+}
+
+static inline block_t* block_cache_pop_call(block_cache_t* cache) {
+    if (cache->ras_depth == 0) return NULL;
+    block_t* call = cache->ras[cache->ras_top];
+    cache->ras_top = (cache->ras_top - 1) & (BLOCK_RAS_SIZE - 1);
+    cache->ras_depth--;
+    return call;
+}
+
+// Invalidate blocks with code in the physical page holding address
+void block_cache_code_write(block_cache_t* cache, uint64_t address);
+
+// Invalidate blocks fetched through the virtual page holding address (SFENCE.VMA)
+void block_cache_unmap(block_cache_t* cache, reg_t address);
+
+#endif // BLOCK_CACHE_H
@@ -0,0 +1,89 @@
+#ifndef CORE_NAMES_H
+#define CORE_NAMES_H
+
+// The core is compiled once per XLEN into the same binary (machine.h), so
+// every external symbol gets an _rv32/_rv64 suffix. Add new ones here.
+#define CORE_NAME(name) CORE_NAME_(name, XLEN)
+#define CORE_NAME_(name, xlen) CORE_NAME__(name, xlen)
+#define CORE_NAME__(name, xlen) name##_rv##xlen
+
+// cpu.c
+#define cpu_init CORE_NAME(cpu_init)
+#define cpu_destroy CORE_NAME(cpu_destroy)
+#define cpu_execute CORE_NAME(cpu_execute)
+#define cpu_execute_decoded CORE_NAME(cpu_execute_decoded)
+#define cpu_fetch CORE_NAME(cpu_fetch)
+#define cpu_decode CORE_NAME(cpu_decode)
+#define cpu_run CORE_NAME(cpu_run)
+#define cpu_trap CORE_NAME(cpu_trap)
+#define cpu_raise CORE_NAME(cpu_raise)
+
+// decode.c, decode_batch.c, decode_table.c
+#define decode_instruction CORE_NAME(decode_instruction)
+#define expand_compressed CORE_NAME(expand_compressed)
+#define decode_compressed CORE_NAME(decode_compressed)
+#define decode_rvc_table CORE_NAME(decode_rvc_table)
+#define decode_batch CORE_NAME(decode_batch)
+#define decode_batch_init CORE_NAME(decode_batch_init)
+#define decode_tables CORE_NAME(decode_tables)
+#define inst_flags CORE_NAME(inst_flags)
+
+// jump_table.c, threaded.c
+#define instruction_table CORE_NAME(instruction_table)
+#define instruction_table_bare CORE_NAME(instruction_table_bare)
+#define threaded_variant CORE_NAME(threaded_variant)
+#define threaded_execute_block CORE_NAME(threaded_execute_block)
+
+// icache.c, block_cache.c, fusion.c
+#define icache_create CORE_NAME(icache_create)
+#define icache_destroy CORE_NAME(icache_destroy)
+#define icache_lookup CORE_NAME(icache_lookup)
+#define icache_flush CORE_NAME(icache_flush)
+#define icache_code_write CORE_NAME(icache_code_write)
+#define icache_unmap CORE_NAME(icache_unmap)
+#define block_cache_create CORE_NAME(block_cache_create)
+#define block_cache_destroy CORE_NAME(block_cache_destroy)
+#define block_cache_lookup CORE_NAME(block_cache_lookup)
+#define block_cache_find CORE_NAME(block_cache_find)
+#define block_cache_build CORE_NAME(block_cache_build)
+#define block_cache_heat CORE_NAME(block_cache_heat)
+#define block_cache_flush CORE_NAME(block_cache_flush)
+#define block_cache_sync CORE_NAME(block_cache_sync)
+#define block_cache_code_write CORE_NAME(block_cache_code_write)
+#define block_cache_unmap CORE_NAME(block_cache_unmap)
+#define block_ends_with CORE_NAME(block_ends_with)
+#define fuse_block CORE_NAME(fuse_block)
+#define fusion_first_type CORE_NAME(fusion_first_type)
+#define fusion_name CORE_NAME(fusion_name)
+
+// mmu.c
+#define mmu_init CORE_NAME(mmu_init)
+#define mmu_update CORE_NAME(mmu_update)
+#define mmu_write_satp CORE_NAME(mmu_write_satp)
+#define mmu_fence CORE_NAME(mmu_fence)
+#define mmu_pmp_changed CORE_NAME(mmu_pmp_changed)
+#define mmu_translate CORE_NAME(mmu_translate)
+#define mmu_read_slow CORE_NAME(mmu_read_slow)
+#define mmu_write_slow CORE_NAME(mmu_write_slow)
+
+// csr.c
+#define csr_read CORE_NAME(csr_read)
+#define csr_write CORE_NAME(csr_write)
+
+// pmp.c
+#define pmp_init CORE_NAME(pmp_init)
+#define pmp_destroy CORE_NAME(pmp_destroy)
+#define pmp_read CORE_NAME(pmp_read)
+#define pmp_write CORE_NAME(pmp_write)
+#define pmp_page CORE_NAME(pmp_page)
+#define pmp_scan CORE_NAME(pmp_scan)
+
+// jit.c
+#define jit_create CORE_NAME(jit_create)
+#define jit_destroy CORE_NAME(jit_destroy)
+#define jit_reset CORE_NAME(jit_reset)
+#define jit_translate CORE_NAME(jit_translate)
+#define jit_link CORE_NAME(jit_link)
+#define jit_invalidate CORE_NAME(jit_invalidate)
+
+#endif // CORE_NAMES_H
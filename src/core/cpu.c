@@ -2,72 +2,539 @@
 #include "decode.h"
 #include "memory.h"
 #include "jump_table.h"
+#include "icache.h"
+#include "block_cache.h"
+#include "threaded.h"
+#include "jit.h"
+#include "mmu.h"
+#include "pmp.h"
+#include "csr.h"
 #include <stdio.h>
 #include <math.h>
-
-// Flag to track if jump table is initialized
-static int jump_table_initialized = 0;
+#include <assert.h>
+#include <setjmp.h>
+#if MEMORY_SANDBOX
+#include <signal.h>
+#include <string.h>
+#endif
 
 void cpu_init(cpu_t* cpu) {
-    // Initialize jump table on first CPU init
-    if (!jump_table_initialized) {
-        init_jump_table();
-        jump_table_initialized = 1;
-    }
-    
     for (int i = 0; i < NUM_REGISTERS; i++) {
         cpu->regs[i] = 0;
         cpu->fregs[i] = 0.0f;
         cpu->dfregs[i] = 0.0;
     }
-    for (int i = 0; i < 4096; i++) {
+    cpu->regs[REG_SINK] = 0;
+    for (int i = 0; i < CSR_SLOTS; i++) {
         cpu->csrs[i] = 0;
     }
+    cpu->fcsr = 0;
     cpu->pc = 0;
     cpu->privilege = MACHINE_MODE;
     cpu->reserved_address = 0;
     cpu->reservation_set = 0;
+    cpu->instret = 0;
+    cpu->icache = NULL;
+    cpu->blocks = NULL;
+    cpu->fusion = 1;
+    cpu->jit = 1;
+    cpu->warm_threshold = CPU_WARM_THRESHOLD;
+    cpu->hot_threshold = CPU_HOT_THRESHOLD;
+    for (int i = 0; i < CPU_TIERS; i++) {
+        cpu->tier_instret[i] = 0;
+    }
+    mmu_init(&cpu->mmu);
+    pmp_init(&cpu->pmp);
 }
 
-void cpu_execute(cpu_t* cpu, memory_t* memory, uint32_t instruction) {
-    // Check if it's a compressed instruction (bits 1:0 != 11)
+void cpu_destroy(cpu_t* cpu) {
+    block_cache_destroy(cpu->blocks);
+    icache_destroy(cpu->icache);
+    cpu->blocks = NULL;
+    cpu->icache = NULL;
+    pmp_destroy(&cpu->pmp);
+}
+
+// Handlers write RD unconditionally: an x0 destination is redirected to the
+// sink slot here, so regs[0] is never written and reads of x0 stay 0
+int cpu_decode(uint32_t instruction, instruction_t* decoded) {
     if ((instruction & 0x3) != 0x3) {
-        // 16-bit compressed instruction
-        uint16_t c_inst = instruction & 0xFFFF;
-        uint32_t expanded = expand_compressed(c_inst);
-        if (expanded != 0) {
-            instruction_t decoded;
-            decode_instruction(expanded, &decoded);
-            // Execute the expanded instruction (without PC increment)
-            cpu_execute_decoded(cpu, memory, &decoded, instruction);
-        }
-        cpu->pc += 2; // 16-bit increment
-        return;
+        decode_compressed(instruction & 0xFFFF, decoded);
+    } else {
+        decode_instruction(instruction, decoded);
     }
-    
-    // 32-bit regular instruction
+    if (decoded->rd == 0 && (inst_flags[decoded->inst_type] & INST_F_RD)) decoded->rd = REG_SINK;
+    return decoded->inst_type != INST_UNKNOWN;
+}
+
+void cpu_execute(cpu_t* cpu, memory_t* memory, uint32_t instruction) {
     instruction_t decoded;
-    decode_instruction(instruction, &decoded);
-    cpu_execute_decoded(cpu, memory, &decoded, instruction);
-    cpu->pc += 4; // 32-bit increment
+    cpu_decode(instruction, &decoded);
+    cpu_execute_decoded(cpu, memory, &decoded);
+}
+
+// Handler set for the current translation mode. Only traps and system
+// instructions (which end blocks) change it, so the tiers pick it once per
+// block and bare-metal code never checks the MMU per access.
+static inline const inst_func_t* cpu_handlers(const cpu_t* cpu) {
+    return mmu_data_bare(cpu) ? instruction_table_bare : instruction_table;
 }
 
-void cpu_execute_decoded(cpu_t* cpu, memory_t* memory, instruction_t* decoded, uint32_t instruction) {
+// Handlers return the next pc: fallthrough, branch/jump target or trap vector
+void cpu_execute_decoded(cpu_t* cpu, memory_t* memory, const instruction_t* decoded) {
     // BLAZING FAST JUMP TABLE DISPATCH! 🚀
-    inst_func_t handler = instruction_table[decoded->inst_type];
-    handler(cpu, memory, decoded, instruction);
+    inst_func_t handler = cpu_handlers(cpu)[decoded->inst_type];
+    cpu->pc = handler(cpu, memory, decoded);
+}
+
+// Fetch the instruction at pc. A 32-bit instruction is assembled from two
+// halfwords so it may straddle any boundary once RVC has misaligned the stream;
+// each half is translated on its own, as the halves may be on different pages.
+int cpu_fetch(cpu_t* cpu, memory_t* memory, reg_t pc, uint32_t* instruction) {
+    uint64_t phys;
+    if (mmu_translate(cpu, memory, pc, MMU_FETCH, &phys) || !memory_contains(memory, phys, 2)) return 0;
+    uint32_t inst = memory_read_halfword(memory, phys);
+    if ((inst & 0x3) == 0x3) {
+        if (mmu_translate(cpu, memory, pc + 2, MMU_FETCH, &phys) || !memory_contains(memory, phys, 2)) return 0;
+        inst |= (uint32_t)memory_read_halfword(memory, phys) << 16;
+    }
+    *instruction = inst;
+    return 1;
+}
+
+// medeleg hands the trap for cause to S-mode
+static int cpu_trap_delegated(const cpu_t* cpu, uint32_t cause) {
+    return cpu->privilege != MACHINE_MODE && ((cpu->csrs[CSR_SLOT_MEDELEG] >> cause) & 1);
+}
+
+reg_t cpu_trap(cpu_t* cpu, uint32_t cause, reg_t tval) {
+    uint32_t privilege = cpu->privilege;
+    reg_t vector;
+    reg_t status = cpu->csrs[CSR_SLOT_MSTATUS];
+    if (cpu_trap_delegated(cpu, cause)) {
+        // SPP = privilege, SPIE = SIE, SIE = 0 (the sstatus view of mstatus)
+        status = (status & ~(reg_t)(0x1u << 8 | 1u << 5 | 1u << 1)) | privilege << 8 | (status & (1u << 1)) << 4;
+        cpu->csrs[CSR_SLOT_SEPC] = cpu->pc;
+        cpu->csrs[CSR_SLOT_SCAUSE] = cause;
+        cpu->csrs[CSR_SLOT_STVAL] = tval;
+        cpu->privilege = SUPERVISOR_MODE;
+        vector = cpu->csrs[CSR_SLOT_STVEC];
+    } else {
+        // MPP = privilege, MPIE = MIE, MIE = 0
+        status = (status & ~(reg_t)(0x3u << 11 | 1u << 7 | 1u << 3)) | privilege << 11 | (status & (1u << 3)) << 4;
+        cpu->csrs[CSR_SLOT_MEPC] = cpu->pc;
+        cpu->csrs[CSR_SLOT_MCAUSE] = cause;
+        cpu->csrs[CSR_SLOT_MTVAL] = tval;
+        cpu->privilege = MACHINE_MODE;
+        vector = cpu->csrs[CSR_SLOT_MTVEC];
+    }
+    cpu->csrs[CSR_SLOT_MSTATUS] = status;
+    mmu_update(cpu);
+    return vector & ~(reg_t)3; // Exceptions ignore vectored mode
+}
+
+// Stop reason for an exception that finds no trap vector
+static cpu_exit_t cpu_exception_exit(uint32_t cause) {
+    switch (cause) {
+        case CAUSE_FETCH_ACCESS: return CPU_EXIT_FETCH_FAULT;
+        case CAUSE_ILLEGAL_INSTRUCTION: return CPU_EXIT_ILLEGAL;
+        case CAUSE_LOAD_ACCESS:
+        case CAUSE_STORE_ACCESS: return CPU_EXIT_ACCESS_FAULT;
+        default:                 return CPU_EXIT_PAGE_FAULT;
+    }
+}
+
+// Take an exception raised by the instruction at pc, or stop on it with
+// *reason set (returning non-zero) if the vector it would go to, stvec when
+// delegated and mtvec otherwise, is not installed
+static int cpu_exception(cpu_t* cpu, uint32_t cause, reg_t tval, cpu_exit_t* reason) {
+    *reason = cpu_exception_exit(cause);
+    uint32_t vector = cpu_trap_delegated(cpu, cause) ? CSR_SLOT_STVEC : CSR_SLOT_MTVEC;
+    if (cpu->csrs[vector] == 0) return 1;
+    cpu->pc = cpu_trap(cpu, cause, tval);
+    return 0;
+}
+
+// pc cannot be fetched. Untranslated, that is the end of the program;
+// otherwise it is a page or access fault on whichever half failed.
+static int cpu_fetch_fault(cpu_t* cpu, memory_t* memory, cpu_exit_t* reason) {
+    *reason = CPU_EXIT_FETCH_FAULT;
+    if (!cpu->mmu.translate[MMU_FETCH]) return 1;
+    uint64_t phys;
+    reg_t at = cpu->pc;
+    uint32_t cause = mmu_translate(cpu, memory, at, MMU_FETCH, &phys);
+    if (!cause && memory_contains(memory, phys, 2) && (memory_read_halfword(memory, phys) & 0x3) == 0x3) {
+        at += 2;
+        cause = mmu_translate(cpu, memory, at, MMU_FETCH, &phys);
+    }
+    if (!cause) cause = CAUSE_FETCH_ACCESS; // Mapped, but not to RAM
+    return cpu_exception(cpu, cause, at, reason);
+}
+
+// Conditions the host has to service; nothing is executed for them.
+// Returns non-zero with *reason set when the run loop must stop here.
+static inline int cpu_host_exit(cpu_t* cpu, uint32_t inst_type, uint32_t length, cpu_exit_t* reason) {
+    switch (inst_type) {
+        case INST_UNKNOWN:
+            *reason = CPU_EXIT_ILLEGAL;
+            return 1;
+        case INST_ECALL:
+            *reason = CPU_EXIT_ECALL;
+            return cpu->csrs[CSR_SLOT_MTVEC] == 0;
+        case INST_EBREAK:
+            *reason = CPU_EXIT_EBREAK;
+            return cpu->csrs[CSR_SLOT_MTVEC] == 0;
+        case INST_WFI:
+            cpu->pc += length;
+            cpu->instret++;
+            *reason = CPU_EXIT_WFI;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+// Cold tier: fetch and decode straight from memory, with no predecode or
+// block cache cost, up to the end of the basic block at pc or limit
+// instructions, whichever comes first
+static int cpu_interpret(cpu_t* cpu, memory_t* memory, uint64_t limit, cpu_exit_t* reason) {
+    reg_t page = cpu->pc >> MEMORY_PAGE_SHIFT;
+    const inst_func_t* handlers = cpu_handlers(cpu); // Stops at system instructions
+    for (uint64_t i = 0; i < limit; i++) {
+        uint32_t instruction;
+        instruction_t decoded;
+        if (!cpu_fetch(cpu, memory, cpu->pc, &instruction)) return cpu_fetch_fault(cpu, memory, reason);
+        cpu_decode(instruction, &decoded);
+        uint32_t type = decoded.inst_type;
+        if (cpu_host_exit(cpu, type, decoded.length, reason)) return 1;
+        
+        cpu->pc = handlers[type](cpu, memory, &decoded);
+        cpu->instret++;
+        cpu->tier_instret[CPU_TIER_INTERPRET]++;
+        if (block_ends_with(type) || (cpu->pc >> MEMORY_PAGE_SHIFT) != page) break;
+    }
+    return 0;
+}
+
+// Run a block's last op, which may redirect or need the host
+static inline int cpu_block_last(cpu_t* cpu, memory_t* memory, const inst_func_t* handlers,
+                                 predecoded_t* last, cpu_exit_t* reason) {
+    if (cpu_host_exit(cpu, last->inst_type, last->length, reason)) return 1;
+    cpu->pc = handlers[last->inst_type](cpu, memory, last);
+    cpu->instret++;
+    return 0;
+}
+
+// address is physical; predecoded pages and blocks keep the frames they were
+// fetched from, so only code from that frame is dropped, under any mapping
+static void cpu_code_write(void* ctx, uint64_t address) {
+    cpu_t* cpu = ctx;
+    icache_code_write(cpu->icache, address);
+    block_cache_code_write(cpu->blocks, address);
+}
+
+// Kept out of line: inlined into cpu_run_guarded() it would share a frame
+// with sigsetjmp(), which makes the compiler spill the whole run loop
+static __attribute__((noinline)) cpu_exit_t cpu_run_tiers(cpu_t* cpu, memory_t* memory, uint64_t max_instructions) {
+    uint64_t end = cpu->instret + max_instructions;
+    uint64_t limit = max_instructions ? end : UINT64_MAX;
+    cpu_exit_t reason = CPU_EXIT_LIMIT;
+    block_cache_t* blocks = cpu->blocks;
     
-    // Handle special PC cases (JAL, JALR, branches)
-    if (decoded->inst_type == INST_JAL || decoded->inst_type == INST_JALR ||
-        (decoded->inst_type >= INST_BEQ && decoded->inst_type <= INST_BGEU &&
-         ((decoded->inst_type == INST_BEQ && cpu->regs[decoded->rs1] == cpu->regs[decoded->rs2]) ||
-          (decoded->inst_type == INST_BNE && cpu->regs[decoded->rs1] != cpu->regs[decoded->rs2]) ||
-          (decoded->inst_type == INST_BLT && (sreg_t)cpu->regs[decoded->rs1] < (sreg_t)cpu->regs[decoded->rs2]) ||
-          (decoded->inst_type == INST_BGE && (sreg_t)cpu->regs[decoded->rs1] >= (sreg_t)cpu->regs[decoded->rs2]) ||
-          (decoded->inst_type == INST_BLTU && cpu->regs[decoded->rs1] < cpu->regs[decoded->rs2]) ||
-          (decoded->inst_type == INST_BGEU && cpu->regs[decoded->rs1] >= cpu->regs[decoded->rs2])))) {
-        return; // PC already modified, don't increment
+    block_t* prev = NULL;
+    while (max_instructions == 0 || cpu->instret < end) {
+        // instret is exact between blocks; a fault recounts the block set
+        // here once one is running
+        blocks->running = NULL;
+        if (blocks->flush_pending) {
+            block_cache_sync(blocks);
+            prev = NULL;
+        }
+        // Code fetched through translation is cached apart from physical code
+        if (blocks->space != cpu->mmu.paging[MMU_FETCH]) {
+            blocks->space = cpu->mmu.paging[MMU_FETCH];
+            blocks->ras_depth = 0;
+            prev = NULL;
+        }
+        
+        // Follow the previous block's chain link before hashing the pc. A
+        // return goes to the block after its call; other indirect jumps try
+        // the target they took last time.
+        block_t* block = NULL;
+        block_t* call = NULL;
+        int edge = -1;
+        if (prev) {
+            if (prev->kind & BLOCK_RETURN) {
+                call = block_cache_pop_call(blocks);
+                if (call && call->end_pc != cpu->pc) call = NULL;
+            }
+            if (call) {
+                if (call->next[0] && call->next[0]->valid) {
+                    block = call->next[0];
+                    blocks->ras_hits++;
+                }
+            } else {
+                if (cpu->pc == prev->next_pc[0]) edge = 0;
+                else if (cpu->pc == prev->next_pc[1]) edge = 1;
+                else if (prev->kind & BLOCK_INDIRECT) {
+                    prev->next_pc[1] = cpu->pc;
+                    prev->next[1] = NULL;
+                    edge = 1;
+                    blocks->ic_misses++;
+                }
+                if (edge >= 0 && prev->next[edge] && prev->next[edge]->valid) {
+                    block = prev->next[edge];
+                    if (edge == 1 && (prev->kind & BLOCK_INDIRECT)) blocks->ic_hits++;
+                    else blocks->chained++;
+                }
+            }
+            if (prev->kind & BLOCK_CALL) block_cache_push_call(blocks, prev);
+        }
+        if (!block) {
+            uint64_t flushes = blocks->flushes;
+            block = block_cache_find(blocks, cpu->pc);
+            if (!block) {
+                if (block_cache_heat(blocks, cpu->pc) <= cpu->warm_threshold) {
+                    // Cold code is interpreted until its leader has been reached often enough
+                    if (cpu_interpret(cpu, memory, limit - cpu->instret, &reason)) return reason;
+                    prev = NULL;
+                    continue;
+                }
+                block = block_cache_build(blocks, cpu, memory, cpu->pc);
+                if (!block) {
+                    if (cpu_fetch_fault(cpu, memory, &reason)) return reason;
+                    prev = NULL;
+                    continue;
+                }
+            }
+            // Building may have recycled the arena under prev
+            if (blocks->flushes != flushes) prev = NULL;
+            else if (call) call->next[0] = block;
+            else if (edge >= 0) prev->next[edge] = block;
+        }
+        // A cached block stays valid across privilege, SUM and PMP changes,
+        // but executing it has to be allowed
+        if (cpu->mmu.translate[MMU_FETCH] && !mmu_fetchable(cpu, memory, block->pc)) {
+            if (cpu_fetch_fault(cpu, memory, &reason)) return reason;
+            prev = NULL;
+            continue;
+        }
+        
+        // Not enough budget left for the whole block: finish instruction by instruction
+        if (max_instructions != 0 && end - cpu->instret < block->count) {
+            if (cpu_interpret(cpu, memory, end - cpu->instret, &reason)) return reason;
+            prev = NULL;
+            continue;
+        }
+        
+#if JIT_CODE
+        // Hot blocks run as x86-64 code, possibly through several chained
+        // blocks; translated code accesses memory untranslated
+        jit_t* jit = blocks->jit;
+        if (jit && cpu->jit && mmu_bare(cpu)) {
+            if (!block->jit_code && ++block->hits >= cpu->hot_threshold && !jit_translate(jit, block)) {
+                block_cache_flush(blocks); // Code cache full: start over at the next block
+            }
+            if (block->jit_code) {
+                if (prev && prev->jit_code) jit_link(jit, prev, block);
+                uint64_t start = cpu->instret;
+                int status = jit_execute(jit, cpu, memory, block, limit);
+                prev = jit->exit_block;
+                int stop = 0;
+                if (status != 0) {
+                    // The last op can fault (a CSR access): recount from the
+                    // exit block, which has retired all but it
+                    blocks->running = prev;
+                    blocks->running_instret = cpu->instret - (prev->count - 1);
+                    stop = cpu_block_last(cpu, memory, instruction_table_bare, prev->ops + prev->count - 1, &reason);
+                }
+                cpu->tier_instret[CPU_TIER_JIT] += cpu->instret - start;
+                if (stop) return reason;
+                continue;
+            }
+        }
+#endif
+        
+        // Only the last op can redirect the pc or need the host, unless a
+        // fused pair took it along
+        predecoded_t* last = block->ops + block->count - 1;
+        int bare = mmu_data_bare(cpu); // As cpu_handlers()
+        const inst_func_t* handlers = bare ? instruction_table_bare : instruction_table;
+        blocks->running = block;
+        blocks->running_instret = cpu->instret;
+#if THREADED_CODE
+        if (threaded_execute_block(cpu, memory, block, bare) == 0) {
+            cpu->instret += block->count;
+            prev = block;
+            continue;
+        }
+#else
+        predecoded_t* op = block->ops;
+        while (op < last) {
+            cpu->pc = handlers[op->inst_type](cpu, memory, op);
+            op += 1 + op->pair;
+        }
+        if (op > last) {
+            cpu->instret += block->count;
+            prev = block;
+            continue;
+        }
+#endif
+        cpu->instret += block->count - 1;
+        
+        if (cpu_block_last(cpu, memory, handlers, last, &reason)) return reason;
+        prev = block;
     }
+    return CPU_EXIT_LIMIT;
+}
+
+// One hart runs at a time, so faults find their way back through these
+static sigjmp_buf* fault_jump;
+static uint32_t fault_cause;    // 0: host fault in the sandbox window
+static uint64_t fault_address;
+
+void cpu_raise(cpu_t* cpu, uint32_t cause, reg_t tval) {
+    (void)cpu;
+    fault_cause = cause;
+    fault_address = tval;
+    siglongjmp(*fault_jump, 1);
+}
+
+#if MEMORY_SANDBOX
+static memory_t* sandbox_memory;
+
+static void cpu_sandbox_fault(int sig, siginfo_t* info, void* context) {
+    (void)context;
+    if (!fault_jump || !memory_fault_address(sandbox_memory, info->si_addr, &fault_address)) {
+        // Not a guest access: crash where it happened
+        signal(sig, SIG_DFL);
+        return;
+    }
+    fault_cause = 0;
+    siglongjmp(*fault_jump, 1);
+}
+#endif
+
+// Access fault cause for inst_type; 0 if it does not access memory
+static uint32_t cpu_access_cause(uint32_t inst_type) {
+    switch (inst_type) {
+        case INST_LB: case INST_LH: case INST_LW: case INST_LBU: case INST_LHU:
+        case INST_LWU: case INST_LD: case INST_FLW: case INST_FLD:
+        case INST_LR_W: case INST_LR_D:
+            return CAUSE_LOAD_ACCESS;
+        case INST_SB: case INST_SH: case INST_SW: case INST_SD: case INST_FSW:
+        case INST_SC_W: case INST_AMOSWAP_W: case INST_AMOADD_W: case INST_AMOXOR_W:
+        case INST_AMOAND_W: case INST_AMOOR_W: case INST_AMOMIN_W: case INST_AMOMAX_W:
+        case INST_AMOMINU_W: case INST_AMOMAXU_W:
+        case INST_SC_D: case INST_AMOSWAP_D: case INST_AMOADD_D: case INST_AMOXOR_D:
+        case INST_AMOAND_D: case INST_AMOOR_D: case INST_AMOMIN_D: case INST_AMOMAX_D:
+        case INST_AMOMINU_D: case INST_AMOMAXU_D:
+            return CAUSE_STORE_ACCESS;
+        default:
+            return 0;
+    }
+}
+
+// A guest access faulted part way through an instruction: a page or access
+// fault raised by the MMU, or (cause 0) a host fault in the sandbox window.
+// Every tier keeps pc on the instruction making it (or on the first op of its
+// fused pair), and the block it ran in is recounted up to there. Takes the
+// trap, or stops with pc on the instruction if no trap vector is installed.
+// CSR accesses raise illegal instruction the same way. They end blocks and
+// are never fused, so pc is on them already, but the block still has to be
+// recounted: blocks retire up front, the JIT's exit block included.
+static int cpu_fault(cpu_t* cpu, memory_t* memory, uint32_t cause, uint64_t address, cpu_exit_t* reason) {
+    if (cause != CAUSE_ILLEGAL_INSTRUCTION) {
+        uint32_t instruction = 0;
+        instruction_t decoded;
+        cpu_fetch(cpu, memory, cpu->pc, &instruction);
+        cpu_decode(instruction, &decoded);
+        uint32_t access = cpu_access_cause(decoded.inst_type);
+        if (!access) {
+            // The first op of the pair has run
+            cpu->pc += decoded.length;
+            cpu_fetch(cpu, memory, cpu->pc, &instruction);
+            cpu_decode(instruction, &decoded);
+            access = cpu_access_cause(decoded.inst_type);
+        }
+        // AMOs report the read half as a store/AMO fault too
+        if (!cause) cause = access;
+        else if (access == CAUSE_STORE_ACCESS && cause == CAUSE_LOAD_ACCESS) cause = CAUSE_STORE_ACCESS;
+        else if (access == CAUSE_STORE_ACCESS && cause == CAUSE_LOAD_PAGE_FAULT) cause = CAUSE_STORE_PAGE_FAULT;
+    }
+
+    block_t* block = cpu->blocks->running;
+    if (block) {
+        uint64_t retired = 0;
+        reg_t at = block->pc;
+        while (retired < block->count && at != cpu->pc) at += block->ops[retired++].length;
+        cpu->instret = cpu->blocks->running_instret + retired;
+        cpu->blocks->running = NULL;
+    }
+    return cpu_exception(cpu, cause, (reg_t)address, reason);
+}
+
+// cpu_run_tiers() with faults taken part way through an instruction (and in
+// sandboxed builds, host faults in the guest window) turned into exceptions;
+// the tiers restart after each one
+static cpu_exit_t cpu_run_guarded(cpu_t* cpu, memory_t* memory, uint64_t max_instructions) {
+#if MEMORY_SANDBOX
+    struct sigaction action, old_segv, old_bus;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = cpu_sandbox_fault;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGSEGV, &action, &old_segv);
+    sigaction(SIGBUS, &action, &old_bus);
+    sandbox_memory = memory;
+#endif
+
+    uint64_t end = cpu->instret + max_instructions;
+    cpu_exit_t reason;
+    sigjmp_buf jump;
+    fault_jump = &jump;
+    for (;;) {
+        // Only a signal handler leaves with SIGSEGV blocked
+        if (sigsetjmp(jump, MEMORY_SANDBOX) == 0) {
+            reason = cpu_run_tiers(cpu, memory, max_instructions ? end - cpu->instret : 0);
+            break;
+        }
+        if (cpu_fault(cpu, memory, fault_cause, fault_address, &reason)) break;
+        if (max_instructions && cpu->instret >= end) {
+            reason = CPU_EXIT_LIMIT;
+            break;
+        }
+    }
+    fault_jump = NULL;
+
+#if MEMORY_SANDBOX
+    sigaction(SIGSEGV, &old_segv, NULL);
+    sigaction(SIGBUS, &old_bus, NULL);
+#endif
+    return reason;
+}
+
+cpu_exit_t cpu_run(cpu_t* cpu, memory_t* memory, uint64_t max_instructions) {
+    if (!cpu->icache) {
+        cpu->icache = icache_create();
+        if (!cpu->icache) return CPU_EXIT_FETCH_FAULT;
+    }
+    if (!cpu->blocks) {
+        cpu->blocks = block_cache_create();
+        if (!cpu->blocks) return CPU_EXIT_FETCH_FAULT;
+        cpu->blocks->fusion = cpu->fusion;
+    }
+    memory->code_hook = cpu_code_write;
+    memory->code_hook_ctx = cpu;
+    
+    // The interpreter and JIT count their own instructions; blocks get the rest
+    uint64_t instret = cpu->instret;
+    uint64_t counted = cpu->tier_instret[CPU_TIER_INTERPRET] + cpu->tier_instret[CPU_TIER_JIT];
+    cpu_exit_t reason = cpu_run_guarded(cpu, memory, max_instructions);
+    counted = cpu->tier_instret[CPU_TIER_INTERPRET] + cpu->tier_instret[CPU_TIER_JIT] - counted;
+    cpu->tier_instret[CPU_TIER_BLOCK] += cpu->instret - instret - counted;
+    assert(cpu->regs[0] == 0);
+    return reason;
 }
 
 // LEGACY SWITCH VERSION (commented out for reference)
@@ -349,28 +816,28 @@ void cpu_execute_decoded_legacy(cpu_t* cpu, memory_t* memory, instruction_t* dec
         case INST_ECALL:
             // Save current PC to MEPC/SEPC based on privilege
             if (cpu->privilege == USER_MODE) {
-                cpu->csrs[CSR_MEPC] = cpu->pc;
-                cpu->csrs[CSR_MCAUSE] = 8; // Environment call from U-mode
+                cpu->csrs[CSR_SLOT_MEPC] = cpu->pc;
+                cpu->csrs[CSR_SLOT_MCAUSE] = 8; // Environment call from U-mode
             } else if (cpu->privilege == SUPERVISOR_MODE) {
-                cpu->csrs[CSR_SEPC] = cpu->pc;
-                cpu->csrs[CSR_SCAUSE] = 8; // Environment call from S-mode
+                cpu->csrs[CSR_SLOT_SEPC] = cpu->pc;
+                cpu->csrs[CSR_SLOT_SCAUSE] = 8; // Environment call from S-mode
             } else { // MACHINE_MODE
-                cpu->csrs[CSR_MEPC] = cpu->pc;
-                cpu->csrs[CSR_MCAUSE] = 11; // Environment call from M-mode
+                cpu->csrs[CSR_SLOT_MEPC] = cpu->pc;
+                cpu->csrs[CSR_SLOT_MCAUSE] = 11; // Environment call from M-mode
             }
             // All traps enter M-mode
             cpu->privilege = MACHINE_MODE;
-            cpu->pc = cpu->csrs[CSR_MTVEC];
+            cpu->pc = cpu->csrs[CSR_SLOT_MTVEC];
             return;
         case INST_EBREAK:
-            cpu->csrs[CSR_MEPC] = cpu->pc;
-            cpu->csrs[CSR_MCAUSE] = 3; // Breakpoint
+            cpu->csrs[CSR_SLOT_MEPC] = cpu->pc;
+            cpu->csrs[CSR_SLOT_MCAUSE] = 3; // Breakpoint
             cpu->privilege = MACHINE_MODE;
-            cpu->pc = cpu->csrs[CSR_MTVEC];
+            cpu->pc = cpu->csrs[CSR_SLOT_MTVEC];
             return;
         case INST_MRET: {
-            uint32_t mstatus = cpu->csrs[CSR_MSTATUS];
-            cpu->pc = cpu->csrs[CSR_MEPC];
+            uint32_t mstatus = cpu->csrs[CSR_SLOT_MSTATUS];
+            cpu->pc = cpu->csrs[CSR_SLOT_MEPC];
             // Restore previous privilege mode from MPP
             cpu->privilege = (mstatus >> 11) & 0x3;
             // Set MPIE to MIE, and MIE to 1
@@ -378,12 +845,12 @@ void cpu_execute_decoded_legacy(cpu_t* cpu, memory_t* memory, instruction_t* dec
             mstatus |= (1 << 7); // Set MPIE to 1
             // Set MPP to User Mode (0)
             mstatus &= ~(0x3 << 11);
-            cpu->csrs[CSR_MSTATUS] = mstatus;
+            cpu->csrs[CSR_SLOT_MSTATUS] = mstatus;
             return;
         }
         case INST_SRET: {
-            uint32_t sstatus = cpu->csrs[CSR_SSTATUS];
-            cpu->pc = cpu->csrs[CSR_SEPC];
+            uint32_t sstatus = cpu->csrs[CSR_SLOT_MSTATUS];
+            cpu->pc = cpu->csrs[CSR_SLOT_SEPC];
             // Restore previous privilege mode from SPP
             cpu->privilege = (sstatus >> 8) & 0x1;
             // Set SPIE to SIE, and SIE to 1
@@ -391,52 +858,64 @@ void cpu_execute_decoded_legacy(cpu_t* cpu, memory_t* memory, instruction_t* dec
             sstatus |= (1 << 5); // Set SPIE to 1
             // Set SPP to User Mode (0)
             sstatus &= ~(0x1 << 8);
-            cpu->csrs[CSR_SSTATUS] = sstatus;
+            cpu->csrs[CSR_SLOT_MSTATUS] = sstatus;
             return;
         }
         case INST_URET:
             // URET is an illegal instruction in most implementations
-            cpu->csrs[CSR_MEPC] = cpu->pc;
-            cpu->csrs[CSR_MCAUSE] = 2; // Illegal instruction
+            cpu->csrs[CSR_SLOT_MEPC] = cpu->pc;
+            cpu->csrs[CSR_SLOT_MCAUSE] = 2; // Illegal instruction
             cpu->privilege = MACHINE_MODE;
-            cpu->pc = cpu->csrs[CSR_MTVEC];
+            cpu->pc = cpu->csrs[CSR_SLOT_MTVEC];
             return;
-        case INST_CSRRW:
+        case INST_CSRRW: {
+            reg_t old = csr_read(cpu, decoded->imm);
+            csr_write(cpu, decoded->imm, cpu->regs[decoded->rs1]);
             if (decoded->rd != 0) {
-                cpu->regs[decoded->rd] = cpu->csrs[decoded->imm];
+                cpu->regs[decoded->rd] = old;
             }
-            cpu->csrs[decoded->imm] = cpu->regs[decoded->rs1];
             break;
-        case INST_CSRRS:
+        }
+        case INST_CSRRS: {
+            reg_t old = csr_read(cpu, decoded->imm);
+            csr_write(cpu, decoded->imm, old | cpu->regs[decoded->rs1]);
             if (decoded->rd != 0) {
-                cpu->regs[decoded->rd] = cpu->csrs[decoded->imm];
+                cpu->regs[decoded->rd] = old;
             }
-            cpu->csrs[decoded->imm] |= cpu->regs[decoded->rs1];
             break;
-        case INST_CSRRC:
+        }
+        case INST_CSRRC: {
+            reg_t old = csr_read(cpu, decoded->imm);
+            csr_write(cpu, decoded->imm, old & ~cpu->regs[decoded->rs1]);
             if (decoded->rd != 0) {
-                cpu->regs[decoded->rd] = cpu->csrs[decoded->imm];
+                cpu->regs[decoded->rd] = old;
             }
-            cpu->csrs[decoded->imm] &= ~cpu->regs[decoded->rs1];
             break;
-        case INST_CSRRWI:
+        }
+        case INST_CSRRWI: {
+            reg_t old = csr_read(cpu, decoded->imm);
+            csr_write(cpu, decoded->imm, decoded->rs1);
             if (decoded->rd != 0) {
-                cpu->regs[decoded->rd] = cpu->csrs[decoded->imm];
+                cpu->regs[decoded->rd] = old;
             }
-            cpu->csrs[decoded->imm] = decoded->rs1;
             break;
-        case INST_CSRRSI:
+        }
+        case INST_CSRRSI: {
+            reg_t old = csr_read(cpu, decoded->imm);
+            csr_write(cpu, decoded->imm, old | decoded->rs1);
             if (decoded->rd != 0) {
-                cpu->regs[decoded->rd] = cpu->csrs[decoded->imm];
+                cpu->regs[decoded->rd] = old;
             }
-            cpu->csrs[decoded->imm] |= decoded->rs1;
             break;
-        case INST_CSRRCI:
+        }
+        case INST_CSRRCI: {
+            reg_t old = csr_read(cpu, decoded->imm);
+            csr_write(cpu, decoded->imm, old & ~(reg_t)decoded->rs1);
             if (decoded->rd != 0) {
-                cpu->regs[decoded->rd] = cpu->csrs[decoded->imm];
+                cpu->regs[decoded->rd] = old;
             }
-            cpu->csrs[decoded->imm] &= ~decoded->rs1;
             break;
+        }
         case INST_LR_W: {
             if (decoded->rd != 0) {
                 uint32_t addr = cpu->regs[decoded->rs1];
@@ -640,7 +1119,7 @@ void cpu_execute_decoded_legacy(cpu_t* cpu, memory_t* memory, instruction_t* dec
         case INST_FLD:
             if (decoded->rd != 0) {
                 uint32_t addr = cpu->regs[decoded->rs1] + decoded->imm;
-                uint64_t raw = ((uint64_t)memory_read_word(memory, addr + 4) << 32) | memory_read_word(memory, addr);
+                uint64_t raw = memory_read_doubleword(memory, addr);
                 cpu->dfregs[decoded->rd] = *(double*)&raw;
             }
             break;
@@ -750,16 +1229,13 @@ void cpu_execute_decoded_legacy(cpu_t* cpu, memory_t* memory, instruction_t* dec
         case INST_LD:
             if (decoded->rd != 0) {
                 reg_t addr = cpu->regs[decoded->rs1] + (sreg_t)decoded->imm;
-                uint64_t low = memory_read_word(memory, addr);
-                uint64_t high = memory_read_word(memory, addr + 4);
-                cpu->regs[decoded->rd] = low | (high << 32);
+                cpu->regs[decoded->rd] = memory_read_doubleword(memory, addr);
             }
             break;
         case INST_SD: {
             reg_t addr = cpu->regs[decoded->rs1] + (sreg_t)decoded->imm;
             uint64_t value = cpu->regs[decoded->rs2];
-            memory_write_word(memory, addr, value & 0xFFFFFFFF);
-            memory_write_word(memory, addr + 4, value >> 32);
+            memory_write_doubleword(memory, addr, value);
             break;
         }
         case INST_ADDIW:
@@ -1,16 +1,21 @@
 #ifndef CPU_H
 #define CPU_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include "memory.h"
+#include "machine.h"
 
 #define NUM_REGISTERS 32
+#define REG_SINK NUM_REGISTERS  // Decoded rd for writes to x0; written, never read
 
-// RISC-V Architecture Configuration
+// Width of this instantiation of the core; the build compiles it for both
 #ifndef XLEN
-#define XLEN 32  // Default to RV32, can be overridden with -DXLEN=64
+#define XLEN 32
 #endif
 
+#include "core_names.h"
+
 #if XLEN == 64
 typedef uint64_t reg_t;
 typedef int64_t sreg_t;
@@ -19,6 +24,14 @@ typedef uint32_t reg_t;
 typedef int32_t sreg_t;
 #endif
 
+// Execution tiers (thresholds in machine.h)
+typedef enum {
+    CPU_TIER_INTERPRET = 0,  // Fetch + decode per instruction
+    CPU_TIER_BLOCK,          // Predecoded basic blocks
+    CPU_TIER_JIT,            // Translated blocks (JIT builds)
+    CPU_TIERS
+} cpu_tier_t;
+
 // RISC-V Opcodes
 #define OPCODE_OP       0x33  // R-type arithmetic
 #define OPCODE_OP_IMM   0x13  // I-type arithmetic
@@ -30,6 +43,7 @@ typedef int32_t sreg_t;
 #define OPCODE_JAL      0x6F
 #define OPCODE_JALR     0x67
 #define OPCODE_SYSTEM   0x73  // System instructions
+#define OPCODE_MISC_MEM 0x0F  // FENCE, FENCE.I
 #define OPCODE_AMO      0x2F  // Atomic operations
 #define OPCODE_OP_IMM_32 0x1B // RV64 32-bit immediate operations
 #define OPCODE_OP_32    0x3B  // RV64 32-bit operations
@@ -48,262 +62,229 @@ typedef enum {
     MACHINE_MODE = 3
 } privilege_level_t;
 
+struct icache;
+struct block_cache;
+
+// Address translation (mmu.c). Fetches, loads and stores each have their own
+// direct-mapped TLB of virtual pages; adding host or phys to a virtual address
+// in an entry's page gives its host address or guest physical address.
+typedef enum {
+    MMU_FETCH = 0,
+    MMU_LOAD,
+    MMU_STORE,
+    MMU_ACCESS_TYPES
+} mmu_access_t;
+
+#define MMU_TLB_SIZE 256            // Entries per access type
+#define MMU_TLB_INVALID (~(reg_t)0) // Tag no access can match
+#define MMU_TLB_GLOBAL    0x01      // PTE.G: kept by an SFENCE.VMA for one ASID
+#define MMU_TLB_SUPERPAGE 0x02      // 4 KiB slice of a megapage/gigapage leaf
+#define MMU_TLB_PMP       0x04      // PMP entries split the frame: each access is checked
+
+typedef struct {
+    reg_t tag;                      // Virtual page for the inline accessors: RAM pages only
+    reg_t page;                     // Virtual page of any translation, or MMU_TLB_INVALID
+    uint32_t flags;                 // MMU_TLB_*
+    uintptr_t host;                 // Valid when tag is
+    uint64_t phys;
+} mmu_tlb_entry_t;
+
+typedef struct {
+    reg_t satp;
+    uint8_t paging[MMU_ACCESS_TYPES];    // Translates through the page table: satp on, privilege below M
+    uint8_t translate[MMU_ACCESS_TYPES]; // Goes through the TLB: paging, or PMP binds the privilege
+    uint8_t code_superpages;        // A fetch went through a superpage since code was last flushed
+    uint32_t context;               // Privileges and SUM/MXR the TLB entries were filled under
+    uint64_t walks;
+    uint64_t flushes;
+    mmu_tlb_entry_t tlb[MMU_ACCESS_TYPES][MMU_TLB_SIZE];
+} mmu_t;
+
+// Physical memory protection (pmp.c): 16 entries, and a permission byte per
+// RAM page so checks are one lookup until the PMP CSRs next change
+#define PMP_ENTRIES 16
+
+typedef struct {
+    uint8_t cfg[PMP_ENTRIES];       // pmpNcfg: R W X, A (address matching), L
+    reg_t addr[PMP_ENTRIES];        // pmpaddrN: physical address bits 2 and up
+    uint64_t lo[PMP_ENTRIES];       // Bytes entry N matches: lo <= address < hi
+    uint64_t hi[PMP_ENTRIES];
+    uint32_t active;                // Entries that match anything, bit per entry
+    uint32_t locked;                // Active entries with L set, which also bind M-mode
+    uint8_t* pages;                 // Per RAM page: PMP_PAGE_* below M (low nibble) and in M
+    uint64_t page_count;
+    int pages_stale;                // Rebuild pages before the next lookup
+    uint64_t rebuilds;
+} pmp_t;
+
+#define CPU_CACHE_LINE 64
+
+// Storage slots of the CSRs that exist, generated from csrs.def (csr.c)
+typedef enum {
+#define CSR(name, ...) CSR_SLOT_##name,
+#include "csrs.def"
+    CSR_SLOTS
+} csr_slot_t;
+
+// A hart. Allocate it CPU_CACHE_LINE aligned (cpu_init() sets it up).
 typedef struct {
-    reg_t regs[NUM_REGISTERS];    // General-purpose registers (x0-x31)
-    float fregs[NUM_REGISTERS];   // Single precision FP registers
-    double dfregs[NUM_REGISTERS]; // Double precision FP registers
-    reg_t pc;                     // Program Counter
-    uint32_t csrs[4096];          // CSRs (always 32-bit)
-    privilege_level_t privilege;  // Current privilege level
-    reg_t reserved_address;       // For LR/SC
-    int reservation_set;          // For LR/SC
+    // Hot header: everything the run loop reads per block and the handlers
+    // per instruction, packed into the first cache lines. Per-block fields
+    // come first, then the register files.
+    struct {
+        reg_t pc;                     // Program Counter
+        uint64_t instret;             // Instructions retired by cpu_run()
+        struct icache* icache;        // Predecoded instructions, created by cpu_run()
+        struct block_cache* blocks;   // Basic blocks built from icache, created by cpu_run()
+        int fusion;                   // Fuse common instruction pairs in blocks (default on)
+        int jit;                      // Translate hot blocks in JIT builds (default on)
+        uint32_t warm_threshold;      // Leader visits before a block is built
+        uint32_t hot_threshold;       // Block entries before it is translated
+        uint64_t tier_instret[CPU_TIERS]; // Instructions retired per tier
+        privilege_level_t privilege;  // Current privilege level
+        int reservation_set;          // For LR/SC
+        reg_t reserved_address;       // For LR/SC
+        uint32_t fcsr;                // fflags (bits 4:0) and frm (7:5)
+        reg_t regs[NUM_REGISTERS + 1]; // x0-x31, then the x0 write sink (x0 itself stays 0)
+        float fregs[NUM_REGISTERS];   // Single precision FP registers
+        double dfregs[NUM_REGISTERS]; // Double precision FP registers
+    } __attribute__((aligned(CPU_CACHE_LINE)));
+    // Translation flags lead mmu_t, right after the header; the TLBs follow
+    mmu_t mmu;                    // satp and the TLBs
+    // Cold: trap handling and configuration
+    reg_t csrs[CSR_SLOTS];        // CSR file; csr_read()/csr_write() apply the hooks
+    pmp_t pmp;
 } cpu_t;
 
+// End of the hot header
+#define CPU_HOT_SIZE offsetof(cpu_t, mmu)
+
+// Decoded instruction, packed into 12 bytes. It is also the predecoded slot
+// format (icache pages, block ops), so every field a handler needs is here and
+// the raw encoding is not kept.
 typedef struct {
-    uint32_t opcode;
-    uint32_t rd;
-    uint32_t rs1;
-    uint32_t rs2;
-    uint32_t imm;
-    uint32_t inst_type;
+    int32_t imm;
+    uint8_t inst_type;  // inst_type_t, index into instruction_table[]
+    uint8_t rd;         // REG_SINK for x0 destinations
+    uint8_t rs1;
+    uint8_t rs2;
+    uint8_t rs3;        // R4-type (FMA) third source
+    uint8_t length;     // 2 or 4; 0 = icache slot not decoded yet
+    uint8_t pair;       // 1 if fused with the next op, which is then skipped
+    uint8_t variant;    // Threaded dispatch variant, set when copied into a block
 } instruction_t;
 
+// Instruction length from the low bits of the first halfword (RVC = 16-bit)
+#define INST_LENGTH(instruction) ((((instruction) & 0x3) == 0x3) ? 4 : 2)
+
 // CSR Addresses
+#define CSR_FFLAGS      0x001
+#define CSR_FRM         0x002
+#define CSR_FCSR        0x003
+
+#define CSR_CYCLE       0xC00
+#define CSR_TIME        0xC01
+#define CSR_INSTRET     0xC02
+#define CSR_CYCLEH      0xC80
+#define CSR_TIMEH       0xC81
+#define CSR_INSTRETH    0xC82
+
 #define CSR_MSTATUS     0x300
 #define CSR_MISA        0x301
+#define CSR_MEDELEG     0x302
+#define CSR_MIDELEG     0x303
 #define CSR_MIE         0x304
 #define CSR_MTVEC       0x305
+#define CSR_MCOUNTEREN  0x306
+#define CSR_MSTATUSH    0x310
+#define CSR_MSCRATCH    0x340
 #define CSR_MEPC        0x341
 #define CSR_MCAUSE      0x342
 #define CSR_MTVAL       0x343
 #define CSR_MIP         0x344
+#define CSR_PMPCFG0     0x3A0
+#define CSR_PMPADDR0    0x3B0
+#define CSR_MCYCLE      0xB00
+#define CSR_MINSTRET    0xB02
+#define CSR_MCYCLEH     0xB80
+#define CSR_MINSTRETH   0xB82
+#define CSR_MVENDORID   0xF11
+#define CSR_MARCHID     0xF12
+#define CSR_MIMPID      0xF13
+#define CSR_MHARTID     0xF14
 
 #define CSR_SSTATUS     0x100
 #define CSR_SIE         0x104
 #define CSR_STVEC       0x105
+#define CSR_SCOUNTEREN  0x106
+#define CSR_SSCRATCH    0x140
 #define CSR_SEPC        0x141
 #define CSR_SCAUSE      0x142
 #define CSR_STVAL       0x143
 #define CSR_SIP         0x144
+#define CSR_SATP        0x180
+
+// mstatus fields used by translation
+#define MSTATUS_MPRV    (1u << 17)  // M-mode loads/stores translate as MPP
+#define MSTATUS_SUM     (1u << 18)  // S-mode may access U pages
+#define MSTATUS_MXR     (1u << 19)  // Loads may read execute-only pages
+
+// SIE SPIE SPP FS SUM MXR: the mstatus bits sstatus shows; mstatus adds MIE
+// MPIE MPP MPRV TVM TW TSR
+#define SSTATUS_WRITABLE 0x000C6122u
+#define MSTATUS_WRITABLE (SSTATUS_WRITABLE | 0x00721888u)
 
-// Instruction types
+// Interrupt bits of mip/mie: software, timer and external, S- and M-level
+#define MIP_SUPERVISOR  0x222u
+#define MIP_ALL         0xAAAu
+
+// Exception causes (mcause/scause)
+#define CAUSE_FETCH_ACCESS      1
+#define CAUSE_ILLEGAL_INSTRUCTION 2
+#define CAUSE_BREAKPOINT        3
+#define CAUSE_LOAD_ACCESS       5
+#define CAUSE_STORE_ACCESS      7   // Store/AMO
+#define CAUSE_ECALL             8   // From U-mode; + privilege level
+#define CAUSE_FETCH_PAGE_FAULT  12
+#define CAUSE_LOAD_PAGE_FAULT   13
+#define CAUSE_STORE_PAGE_FAULT  15  // Store/AMO
+
+// Instruction types, generated from instructions.def
 typedef enum {
-    //R-Type
-    INST_ADD,
-    INST_SUB,
-    INST_MUL,
-    INST_MULH,
-    INST_MULHSU,
-    INST_MULHU,
-    INST_DIV,
-    INST_DIVU,
-    INST_REM,
-    INST_REMU,
-    INST_MULW,
-    INST_DIVW,
-    INST_DIVUW,
-    INST_REMW,
-    INST_REMUW,
-    INST_SLL,
-    INST_SRL,
-    INST_SRA,
-    INST_SLT,
-    INST_SLTU,
-    INST_XOR,
-    INST_OR,
-    INST_AND,
-    //I-Type
-    INST_ADDI,
-    INST_SLTI,
-    INST_SLTIU,
-    INST_XORI,
-    INST_ORI,
-    INST_ANDI,
-    INST_SLLI,
-    INST_SRLI,
-    INST_SRAI,
-    //Loading
-    INST_LB,
-    INST_LH,
-    INST_LW,
-    INST_LBU,
-    INST_LHU,
-    //Storing
-    INST_SB,
-    INST_SH,
-    INST_SW,
-    //Control Transfer
-    INST_BEQ,
-    INST_BNE,
-    INST_BLT,
-    INST_BGE,
-    INST_BLTU,
-    INST_BGEU,
-    INST_JAL,
-    INST_JALR,
-    INST_LUI,
-    INST_AUIPC,
-    // System
-    INST_FENCE,
-    INST_FENCE_I,
-    INST_SFENCE_VMA,
-    INST_WFI,
-    INST_ECALL,
-    INST_EBREAK,
-    INST_MRET,
-    INST_SRET,
-    INST_URET,
-    INST_CSRRW,
-    INST_CSRRS,
-    INST_CSRRC,
-    INST_CSRRWI,
-    INST_CSRRSI,
-    INST_CSRRCI,
-    // Atomic Instructions
-    INST_LR_W,
-    INST_SC_W,
-    INST_AMOSWAP_W,
-    INST_AMOADD_W,
-    INST_AMOXOR_W,
-    INST_AMOAND_W,
-    INST_AMOOR_W,
-    INST_AMOMIN_W,
-    INST_AMOMAX_W,
-    INST_AMOMINU_W,
-    INST_AMOMAXU_W,
-    INST_LR_D,
-    INST_SC_D,
-    INST_AMOSWAP_D,
-    INST_AMOADD_D,
-    INST_AMOXOR_D,
-    INST_AMOAND_D,
-    INST_AMOOR_D,
-    INST_AMOMIN_D,
-    INST_AMOMAX_D,
-    INST_AMOMINU_D,
-    INST_AMOMAXU_D,
-    //Floating point
-    INST_FMADD_S,
-    INST_FMSUB_S,
-    INST_FNMSUB_S,
-    INST_FNMADD_S,
-    INST_FADD_S,
-    INST_FSUB_S,
-    INST_FMUL_S,
-    INST_FDIV_S,
-    INST_FSQRT_S,
-    INST_FSGNJ_S,
-    INST_FSGNJN_S,
-    INST_FSGNJX_S,
-    INST_FMIN_S,
-    INST_FMAX_S,
-    INST_FCVT_W_S,
-    INST_FCVT_WU_S,
-    INST_FMV_X_W,
-    INST_FEQ_S,
-    INST_FLT_S,
-    INST_FLE_S,
-    INST_FCLASS_S,
-    INST_FCVT_S_W,
-    INST_FCVT_S_WU,
-    INST_FMV_W_X,
-    INST_FCVT_L_D,
-    INST_FCVT_LU_D,
-    INST_FMV_X_D,
-    INST_FCVT_D_L,
-    INST_FCVT_D_LU,
-    INST_FMV_D_X,
-    INST_FMADD_D,
-    INST_FMSUB_D,
-    INST_FNMSUB_D,
-    INST_FNMADD_D,
-    INST_FADD_D,
-    INST_FSUB_D,
-    INST_FMUL_D,
-    INST_FDIV_D,
-    INST_FSQRT_D,
-    INST_FSGNJ_D,
-    INST_FSGNJN_D,
-    INST_FSGNJX_D,
-    INST_FMIN_D,
-    INST_FMAX_D,
-    INST_FCVT_S_D,
-    INST_FCVT_D_S,
-    INST_FEQ_D,
-    INST_FLT_D,
-    INST_FLE_D,
-    INST_FCLASS_D,
-    INST_FCVT_W_D,
-    INST_FCVT_WU_D,
-    INST_FCVT_D_W,
-    INST_FCVT_D_WU,
-    INST_FLW,
-    INST_FSW,
-    INST_FLD,
-    // RV32C Compressed Instructions
-    INST_C_ADDI4SPN,
-    INST_C_FLD,
-    INST_C_LW,
-    INST_C_FLW,
-    INST_C_FSD,
-    INST_C_SW,
-    INST_C_FSW,
-    INST_C_NOP,
-    INST_C_ADDI,
-    INST_C_JAL,
-    INST_C_LI,
-    INST_C_ADDI16SP,
-    INST_C_LUI,
-    INST_C_SRLI,
-    INST_C_SRAI,
-    INST_C_ANDI,
-    INST_C_SUB,
-    INST_C_XOR,
-    INST_C_OR,
-    INST_C_AND,
-    INST_C_J,
-    INST_C_BEQZ,
-    INST_C_BNEZ,
-    INST_C_SLLI,
-    INST_C_FLDSP,
-    INST_C_LWSP,
-    INST_C_FLWSP,
-    INST_C_JR,
-    INST_C_MV,
-    INST_C_EBREAK,
-    INST_C_JALR,
-    INST_C_ADD,
-    INST_C_FSDSP,
-    INST_C_SWSP,
-    INST_C_FSWSP,
-    INST_C_LD,
-    INST_C_SD,
-    INST_C_ADDIW,
-    INST_C_ADDW,
-    INST_C_SUBW,
-    INST_C_SLLI64,
-    INST_C_SRLI64,
-    INST_C_SRAI64,
-    // RV64I Instructions
-    INST_LWU,
-    INST_LD,
-    INST_SD,
-    INST_ADDIW,
-    INST_SLLIW,
-    INST_SRLIW,
-    INST_SRAIW,
-    INST_ADDW,
-    INST_SUBW,
-    INST_SLLW,
-    INST_SRLW,
-    INST_SRAW,
-    //Unknown
-    INST_UNKNOWN
+#define INST(name, ...) INST_##name,
+#include "instructions.def"
 } inst_type_t;
 
+// Per-instruction properties (inst_flags[], instructions.def)
+#define INST_F_RD     0x01  // Writes integer register rd
+#define INST_F_PURE   0x02  // Writing rd is the only effect (never a load), so rd == x0 makes it a NOP
+#define INST_F_SHAMT  0x04  // Immediate is a shift amount
+#define INST_F_FUSED  0x08  // Superinstruction covering two adjacent ops (fusion.c)
+
+extern const uint8_t inst_flags[INST_UNKNOWN + 1];
+
 
 void cpu_init(cpu_t* cpu);
+void cpu_destroy(cpu_t* cpu);
 void cpu_execute(cpu_t* cpu, memory_t* memory, uint32_t instruction);
-void cpu_execute_decoded(cpu_t* cpu, memory_t* memory, instruction_t* decoded, uint32_t instruction);
+// Execute a decoded instruction and move pc to the instruction that follows it
+void cpu_execute_decoded(cpu_t* cpu, memory_t* memory, const instruction_t* decoded);
+
+// Fetch the (possibly 16-bit) instruction at pc, translated when fetches are;
+// 0 if it cannot be fetched (outside memory or a fetch fault)
+int cpu_fetch(cpu_t* cpu, memory_t* memory, reg_t pc, uint32_t* instruction);
+// Decode a 16- or 32-bit instruction; 0 for illegal encodings
+int cpu_decode(uint32_t instruction, instruction_t* decoded);
+
+// Take an exception raised by the instruction at pc: M-mode, or S-mode when
+// medeleg delegates it from below M. Returns the trap handler address.
+reg_t cpu_trap(cpu_t* cpu, uint32_t cause, reg_t tval);
+// Abandon the instruction at pc and take the exception from the run loop
+// (faults detected part way through a handler); only valid inside cpu_run()
+void cpu_raise(cpu_t* cpu, uint32_t cause, reg_t tval);
+
+// Fetch/decode/execute from guest memory at cpu->pc until an exit condition.
+// max_instructions == 0 runs without a limit.
+cpu_exit_t cpu_run(cpu_t* cpu, memory_t* memory, uint64_t max_instructions);
 
 #endif // CPU_H
@@ -0,0 +1,177 @@
+#include "csr.h"
+#include "mmu.h"
+#include "pmp.h"
+
+// Floating point: fflags (bits 4:0) and frm (7:5) share fcsr
+static reg_t csr_read_fflags(const cpu_t* cpu, uint32_t csr) {
+    (void)csr;
+    return cpu->fcsr & 0x1F;
+}
+
+static void csr_write_fflags(cpu_t* cpu, uint32_t csr, reg_t value) {
+    (void)csr;
+    cpu->fcsr = (cpu->fcsr & ~0x1Fu) | (value & 0x1F);
+}
+
+static reg_t csr_read_frm(const cpu_t* cpu, uint32_t csr) {
+    (void)csr;
+    return (cpu->fcsr >> 5) & 0x7;
+}
+
+static void csr_write_frm(cpu_t* cpu, uint32_t csr, reg_t value) {
+    (void)csr;
+    cpu->fcsr = (cpu->fcsr & 0x1F) | (value & 0x7) << 5;
+}
+
+static reg_t csr_read_fcsr(const cpu_t* cpu, uint32_t csr) {
+    (void)csr;
+    return cpu->fcsr;
+}
+
+static void csr_write_fcsr(cpu_t* cpu, uint32_t csr, reg_t value) {
+    (void)csr;
+    cpu->fcsr = value & 0xFF;
+}
+
+// One cycle per instruction, and time counts instructions as well. The
+// *H numbers (bit 7 set) are the upper halves on RV32.
+static reg_t csr_read_counter(const cpu_t* cpu, uint32_t csr) {
+#if XLEN == 64
+    (void)csr;
+    return cpu->instret;
+#else
+    return (reg_t)((csr & 0x80) ? cpu->instret >> 32 : cpu->instret);
+#endif
+}
+
+// Writable here only through their hooks' side effects, if any
+static void csr_write_ignore(cpu_t* cpu, uint32_t csr, reg_t value) {
+    (void)cpu;
+    (void)csr;
+    (void)value;
+}
+
+// mstatus bits that change what loads and stores translate (MPP under MPRV)
+#define MSTATUS_TRANSLATION (MSTATUS_MPRV | MSTATUS_SUM | MSTATUS_MXR | 0x1800u)
+
+static void csr_set_mstatus(cpu_t* cpu, reg_t mask, reg_t value) {
+    reg_t old = cpu->csrs[CSR_SLOT_MSTATUS];
+    reg_t status = (old & ~mask) | (value & mask);
+    cpu->csrs[CSR_SLOT_MSTATUS] = status;
+    if ((old ^ status) & MSTATUS_TRANSLATION) mmu_update(cpu);
+}
+
+static void csr_write_mstatus(cpu_t* cpu, uint32_t csr, reg_t value) {
+    (void)csr;
+    csr_set_mstatus(cpu, MSTATUS_WRITABLE, value);
+}
+
+// sstatus is the S-level view of mstatus, not a register of its own
+static reg_t csr_read_sstatus(const cpu_t* cpu, uint32_t csr) {
+    (void)csr;
+    return cpu->csrs[CSR_SLOT_MSTATUS] & SSTATUS_WRITABLE;
+}
+
+static void csr_write_sstatus(cpu_t* cpu, uint32_t csr, reg_t value) {
+    (void)csr;
+    csr_set_mstatus(cpu, SSTATUS_WRITABLE, value);
+}
+
+// sie/sip show the interrupts mideleg hands to S-mode; of sip, only SSIP is
+// writable
+static reg_t csr_read_sie(const cpu_t* cpu, uint32_t csr) {
+    (void)csr;
+    return cpu->csrs[CSR_SLOT_MIE] & cpu->csrs[CSR_SLOT_MIDELEG];
+}
+
+static void csr_write_sie(cpu_t* cpu, uint32_t csr, reg_t value) {
+    (void)csr;
+    reg_t mask = cpu->csrs[CSR_SLOT_MIDELEG];
+    cpu->csrs[CSR_SLOT_MIE] = (cpu->csrs[CSR_SLOT_MIE] & ~mask) | (value & mask);
+}
+
+static reg_t csr_read_sip(const cpu_t* cpu, uint32_t csr) {
+    (void)csr;
+    return cpu->csrs[CSR_SLOT_MIP] & cpu->csrs[CSR_SLOT_MIDELEG];
+}
+
+static void csr_write_sip(cpu_t* cpu, uint32_t csr, reg_t value) {
+    (void)csr;
+    reg_t mask = cpu->csrs[CSR_SLOT_MIDELEG] & 0x2;
+    cpu->csrs[CSR_SLOT_MIP] = (cpu->csrs[CSR_SLOT_MIP] & ~mask) | (value & mask);
+}
+
+// satp lives in the MMU, which flushes the TLBs and code caches when it changes
+static reg_t csr_read_satp(const cpu_t* cpu, uint32_t csr) {
+    (void)csr;
+    return cpu->mmu.satp;
+}
+
+static void csr_write_satp(cpu_t* cpu, uint32_t csr, reg_t value) {
+    (void)csr;
+    mmu_write_satp(cpu, value);
+}
+
+// MXL and the extensions this core implements, fixed
+static reg_t csr_read_misa(const cpu_t* cpu, uint32_t csr) {
+    (void)cpu;
+    (void)csr;
+    reg_t extensions = 0;
+    for (const char* e = "ACDFIMSU"; *e; e++) extensions |= (reg_t)1 << (*e - 'A');
+    return (reg_t)(XLEN == 64 ? 2 : 1) << (XLEN - 2) | extensions;
+}
+
+// The PMP entries live with their checks
+static reg_t csr_read_pmp(const cpu_t* cpu, uint32_t csr) {
+    return pmp_read(&cpu->pmp, csr);
+}
+
+static void csr_write_pmp(cpu_t* cpu, uint32_t csr, reg_t value) {
+    if (pmp_write(&cpu->pmp, csr, value)) mmu_pmp_changed(cpu);
+}
+
+typedef struct {
+    reg_t (*read)(const cpu_t* cpu, uint32_t csr);
+    void (*write)(cpu_t* cpu, uint32_t csr, reg_t value);
+    reg_t mask;
+} csr_entry_t;
+
+static const csr_entry_t csr_table[CSR_SLOTS] = {
+#define CSR(name, read, write, mask) [CSR_SLOT_##name] = { read, write, mask },
+#include "csrs.def"
+};
+
+// Slot + 1 by CSR number, 0 where no CSR exists
+typedef char csr_slot_fits_byte[(CSR_SLOTS < 0xFF) ? 1 : -1];
+
+static const uint8_t csr_map[4096] = {
+#define CSR(name, ...) [CSR_##name] = CSR_SLOT_##name + 1,
+#define CSR_RANGE(name, count, ...) [CSR_##name ... CSR_##name + (count) - 1] = CSR_SLOT_##name + 1,
+#include "csrs.def"
+};
+
+// Slot of csr, accessed at the current privilege. Bits 9:8 of the number are
+// the lowest privilege allowed, and 11:10 all set make it read-only.
+static uint32_t csr_slot(cpu_t* cpu, uint32_t csr, int write) {
+    uint32_t slot = csr_map[csr & 0xFFF];
+    if (!slot || cpu->privilege < ((csr >> 8) & 0x3) || (write && ((csr >> 10) & 0x3) == 0x3)) {
+        cpu_raise(cpu, CAUSE_ILLEGAL_INSTRUCTION, 0);
+    }
+    return slot - 1;
+}
+
+reg_t csr_read(cpu_t* cpu, uint32_t csr) {
+    uint32_t slot = csr_slot(cpu, csr, 0);
+    const csr_entry_t* entry = &csr_table[slot];
+    return entry->read ? entry->read(cpu, csr) : cpu->csrs[slot];
+}
+
+void csr_write(cpu_t* cpu, uint32_t csr, reg_t value) {
+    uint32_t slot = csr_slot(cpu, csr, 1);
+    const csr_entry_t* entry = &csr_table[slot];
+    if (entry->write) {
+        entry->write(cpu, csr, value);
+    } else {
+        cpu->csrs[slot] = (cpu->csrs[slot] & ~entry->mask) | (value & entry->mask);
+    }
+}
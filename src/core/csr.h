@@ -0,0 +1,15 @@
+#ifndef CSR_H
+#define CSR_H
+
+#include "cpu.h"
+
+// CSR file (csrs.def): a slot per CSR that exists in cpu->csrs, found through
+// a byte map indexed by CSR number, and read/write hooks for the CSRs that
+// alias others, live elsewhere or have side effects. A CSR that does not
+// exist, needs a higher privilege or is written while read-only raises an
+// illegal instruction exception (cpu_raise()).
+
+reg_t csr_read(cpu_t* cpu, uint32_t csr);
+void csr_write(cpu_t* cpu, uint32_t csr, reg_t value);
+
+#endif // CSR_H
@@ -3,25 +3,19 @@
 #include "decode_table.h"
 #include <stdio.h>
 
-// Flag to track if decode tables are initialized
-static int decode_tables_initialized = 0;
-
 void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
-    // Initialize decode tables on first use
-    if (!decode_tables_initialized) {
-        init_decode_tables();
-        decode_tables_initialized = 1;
-    }
-    
     // Extract common fields
-    decoded_inst->opcode = instruction & 0x7f;
     decoded_inst->rd = (instruction >> 7) & 0x1f;
     decoded_inst->rs1 = (instruction >> 15) & 0x1f;
     decoded_inst->rs2 = (instruction >> 20) & 0x1f;
-    decoded_inst->imm = (int32_t)(instruction >> 20); // Default I-type
+    decoded_inst->rs3 = (instruction >> 27) & 0x1f;
+    decoded_inst->imm = (int32_t)instruction >> 20; // Default I-type (sign-extended)
+    decoded_inst->length = 4;
+    decoded_inst->pair = 0;
+    decoded_inst->variant = 0;
     
     // 🚀 BLAZING FAST TABLE LOOKUP DISPATCH!
-    uint32_t opcode = decoded_inst->opcode;
+    uint32_t opcode = instruction & 0x7f;
     decode_entry_t entry;
     
     // Fast opcode dispatch with minimal branching
@@ -39,7 +33,7 @@ void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
         case OPCODE_JAL: {
             // J-type immediate - optimized bit extraction
             uint32_t imm20 = (instruction >> 31) & 1;
-            uint32_t imm = ((instruction >> 12) & 0xFF000) |    // imm[19:12]
+            uint32_t imm = (instruction & 0xFF000) |             // imm[19:12]
                           ((instruction >> 20) & 0x7FE) |      // imm[10:1]
                           ((instruction >> 9) & 0x800) |       // imm[11]
                           (imm20 ? 0xFFF00000 : 0);            // sign extend
@@ -62,7 +56,7 @@ void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
             decoded_inst->imm = (int32_t)imm;
             
             uint32_t funct3 = (instruction >> 12) & 0x7;
-            entry = branch_table[funct3];
+            entry = decode_tables.branch[funct3];
             decoded_inst->inst_type = entry.inst_type;
             return;
         }
@@ -74,14 +68,14 @@ void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
             decoded_inst->imm = (int32_t)((imm & 0x800) ? (imm | 0xFFFFF000) : imm);
             
             uint32_t funct3 = (instruction >> 12) & 0x7;
-            entry = store_table[funct3];
+            entry = decode_tables.store[funct3];
             decoded_inst->inst_type = entry.inst_type;
             return;
         }
         
         case OPCODE_LOAD: {
             uint32_t funct3 = (instruction >> 12) & 0x7;
-            entry = load_table[funct3];
+            entry = decode_tables.load[funct3];
             decoded_inst->inst_type = entry.inst_type;
             return;
         }
@@ -93,9 +87,12 @@ void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
             uint32_t effective_funct7 = 0x00;
             if (funct3 == 0x1 || funct3 == 0x5) { // SLLI, SRLI, SRAI
                 effective_funct7 = (instruction >> 25) & 0x7f;
+#if XLEN == 64
+                effective_funct7 &= 0x7e; // Bit 25 is shamt[5]
+#endif
             }
             
-            entry = op_imm_table[effective_funct7][funct3];
+            entry = decode_tables.op_imm[effective_funct7][funct3];
             
             if (entry.has_imm_override) {
                 // Special shamt handling for shifts
@@ -118,7 +115,7 @@ void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
         case OPCODE_OP: {
             uint32_t funct3 = (instruction >> 12) & 0x7;
             uint32_t funct7 = (instruction >> 25) & 0x7f;
-            entry = op_table[funct7][funct3];
+            entry = decode_tables.op[funct7][funct3];
             decoded_inst->inst_type = entry.inst_type;
             return;
         }
@@ -147,11 +144,7 @@ void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
                     decoded_inst->inst_type = INST_FENCE;
                 }
             } else if (funct3 == 0x1) {
-                if (funct12 == 0x001) {
-                    decoded_inst->inst_type = INST_FENCE_I;
-                } else {
-                    decoded_inst->inst_type = INST_CSRRW;
-                }
+                decoded_inst->inst_type = INST_CSRRW;
             } else if (funct3 == 0x2) {
                 decoded_inst->inst_type = INST_CSRRS;
             } else if (funct3 == 0x3) {
@@ -168,10 +161,22 @@ void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
             return;
         }
         
+        case OPCODE_MISC_MEM: {
+            uint32_t funct3 = (instruction >> 12) & 0x7;
+            if (funct3 == 0x0) {
+                decoded_inst->inst_type = INST_FENCE;
+            } else if (funct3 == 0x1) {
+                decoded_inst->inst_type = INST_FENCE_I;
+            } else {
+                decoded_inst->inst_type = INST_UNKNOWN;
+            }
+            return;
+        }
+        
         case OPCODE_AMO: {
             uint32_t funct3 = (instruction >> 12) & 0x7;
             uint32_t funct5 = (instruction >> 27) & 0x1F;
-            entry = amo_table[funct5][funct3];
+            entry = decode_tables.amo[funct5][funct3];
             decoded_inst->inst_type = entry.inst_type;
             return;
         }
@@ -330,6 +335,10 @@ void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
         }
         
         case OPCODE_STORE_FP: {
+            uint32_t imm = ((instruction >> 20) & 0xFE0) |      // S-type, as OPCODE_STORE
+                          ((instruction >> 7) & 0x1F);
+            decoded_inst->imm = (int32_t)((imm & 0x800) ? (imm | 0xFFFFF000) : imm);
+            
             uint32_t funct3 = (instruction >> 12) & 0x7;
             if (funct3 == 0x2) {
                 decoded_inst->inst_type = INST_FSW;
@@ -371,24 +380,8 @@ void decode_instruction(uint32_t instruction, instruction_t* decoded_inst) {
         case OPCODE_OP_32: {
             uint32_t funct3 = (instruction >> 12) & 0x7;
             uint32_t funct7 = (instruction >> 25) & 0x7f;
-            if (funct7 == 0x00 && funct3 == 0x0) {
-                decoded_inst->inst_type = INST_ADDW;
-            }
-            else if (funct7 == 0x20 && funct3 == 0x0) {
-                decoded_inst->inst_type = INST_SUBW;
-            }
-            else if (funct7 == 0x00 && funct3 == 0x1) {
-                decoded_inst->inst_type = INST_SLLW;
-            }
-            else if (funct7 == 0x00 && funct3 == 0x5) {
-                decoded_inst->inst_type = INST_SRLW;
-            }
-            else if (funct7 == 0x20 && funct3 == 0x5) {
-                decoded_inst->inst_type = INST_SRAW;
-            }
-            else {
-                decoded_inst->inst_type = INST_UNKNOWN;
-            }
+            entry = decode_tables.op32[funct7][funct3];
+            decoded_inst->inst_type = entry.inst_type;
             return;
         }
 #endif
@@ -596,4 +589,50 @@ uint32_t expand_compressed(uint16_t c_inst) {
             break;
     }
     return 0; // Invalid compressed instruction
-}
\ No newline at end of file
+}
+// 🚀 PRECOMPUTED RVC DECODE: one entry per 16-bit encoding (quadrants 0-2)
+static rvc_entry_t rvc_table[3 << 14];
+static int rvc_table_ready = 0;
+
+// Expand and fully decode all 49152 encodings once; reserved ones become INST_UNKNOWN
+static void init_rvc_table(void) {
+    for (uint32_t c_inst = 0; c_inst <= 0xFFFF; c_inst++) {
+        if ((c_inst & 0x3) == 0x3) continue;
+        
+        instruction_t decoded = {0};
+        decoded.inst_type = INST_UNKNOWN;
+        uint32_t expanded = expand_compressed((uint16_t)c_inst);
+        if (expanded != 0) {
+            decode_instruction(expanded, &decoded);
+        }
+        if (decoded.rd == 0 && (inst_flags[decoded.inst_type] & INST_F_RD)) decoded.rd = REG_SINK;
+        
+        rvc_entry_t* entry = &rvc_table[RVC_INDEX(c_inst)];
+        entry->imm = decoded.imm;
+        entry->inst_type = decoded.inst_type;
+        entry->rd = decoded.rd;
+        entry->rs1 = decoded.rs1;
+        entry->rs2 = decoded.rs2;
+    }
+    rvc_table_ready = 1;
+}
+
+const rvc_entry_t* decode_rvc_table(void) {
+    if (!rvc_table_ready) init_rvc_table();
+    return rvc_table;
+}
+
+void decode_compressed(uint16_t c_inst, instruction_t* decoded_inst) {
+    if (!rvc_table_ready) init_rvc_table();
+    
+    const rvc_entry_t* entry = &rvc_table[RVC_INDEX(c_inst)];
+    decoded_inst->imm = entry->imm;
+    decoded_inst->inst_type = entry->inst_type;
+    decoded_inst->rd = entry->rd;
+    decoded_inst->rs1 = entry->rs1;
+    decoded_inst->rs2 = entry->rs2;
+    decoded_inst->rs3 = 0;
+    decoded_inst->length = 2;
+    decoded_inst->pair = 0;
+    decoded_inst->variant = 0;
+}
@@ -7,5 +7,30 @@
 
 void decode_instruction(uint32_t instruction, instruction_t* decoded_inst);
 uint32_t expand_compressed(uint16_t c_inst);
+// Decode a 16-bit RVC encoding via a precomputed table (INST_UNKNOWN if reserved).
+// Must not be passed a 32-bit encoding (low bits 11).
+void decode_compressed(uint16_t c_inst, instruction_t* decoded_inst);
+
+// Precomputed RVC decode entry: the first 8 bytes of the instruction_t, with
+// x0 destinations already sent to REG_SINK
+typedef struct {
+    int32_t imm;
+    uint8_t inst_type;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+} rvc_entry_t;
+
+#define RVC_INDEX(c_inst) ((((uint32_t)(c_inst) & 0x3) << 14) | (((uint32_t)(c_inst) & 0xFFFF) >> 2))
+
+// The 3 << 14 entry RVC table, indexed by RVC_INDEX()
+const rvc_entry_t* decode_rvc_table(void);
+
+// Decode count consecutive halfword slots at code, each as cpu_decode() would
+// decode an instruction starting there (AVX2 when built for it, decode_batch.c).
+// code must be readable for count * 2 + 2 bytes. decode_batch_init() builds
+// the tables it uses and must have run first (icache_create() calls it).
+void decode_batch_init(void);
+void decode_batch(const uint8_t* code, uint32_t count, instruction_t* out);
 
 #endif // DECODE_H
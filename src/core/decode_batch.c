@@ -0,0 +1,224 @@
+#include "decode.h"
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// Immediate formats the batch decoder can produce itself. BATCH_SCALAR
+// lanes (SYSTEM, OP_FP) are finished by cpu_decode().
+enum {
+    BATCH_I = 0,
+    BATCH_S,
+    BATCH_B,
+    BATCH_U,
+    BATCH_J,
+    BATCH_SHAMT,    // OP-IMM shifts, XLEN-wide shamt
+    BATCH_SHAMT_W,  // RV64 OP-IMM-32 shifts, 5-bit shamt
+    BATCH_SCALAR
+};
+
+// Entry: inst_type | format << 8 | BATCH_RD
+#define BATCH_RD        0x1000  // inst_flags INST_F_RD: x0 goes to REG_SINK
+#define BATCH_ENTRIES   6144
+
+// Opcodes decoded by table: the instruction type depends only on the
+// (funct7, funct3) bits in mask, and the immediate only on the format
+static const struct {
+    uint8_t opcode;
+    uint16_t mask;      // Of funct7 << 3 | funct3
+    uint8_t fmt;
+} batch_opcodes[] = {
+    { OPCODE_LUI,       0x000, BATCH_U },
+    { OPCODE_AUIPC,     0x000, BATCH_U },
+    { OPCODE_JAL,       0x000, BATCH_J },
+    { OPCODE_JALR,      0x000, BATCH_I },
+    { OPCODE_BRANCH,    0x007, BATCH_B },
+    { OPCODE_LOAD,      0x007, BATCH_I },
+    { OPCODE_STORE,     0x007, BATCH_S },
+    { OPCODE_OP_IMM,    0x3FF, BATCH_I },
+    { OPCODE_OP,        0x3FF, BATCH_I },
+    { OPCODE_MISC_MEM,  0x007, BATCH_I },
+    { OPCODE_AMO,       0x3E7, BATCH_I },   // funct5, funct3 (aq/rl ignored)
+    { OPCODE_MADD,      0x018, BATCH_I },   // funct2
+    { OPCODE_MSUB,      0x018, BATCH_I },
+    { OPCODE_NMSUB,     0x018, BATCH_I },
+    { OPCODE_NMADD,     0x018, BATCH_I },
+    { OPCODE_LOAD_FP,   0x007, BATCH_I },
+    { OPCODE_STORE_FP,  0x007, BATCH_S },
+    { OPCODE_SYSTEM,    0x000, BATCH_SCALAR }, // Keyed on funct12
+    { OPCODE_OP_FP,     0x000, BATCH_SCALAR }, // Keyed on rs2 too
+#if XLEN == 64
+    { OPCODE_OP_IMM_32, 0x3FF, BATCH_I },
+    { OPCODE_OP_32,     0x3FF, BATCH_I },
+#endif
+};
+
+// Per-opcode descriptors (entry base | key mask << 16) and the flat entry
+// array they index, both 32-bit for the gathers. RVC lanes gather from the
+// precomputed RVC table instead.
+static struct {
+    int32_t opcodes[128];
+    int32_t entries[BATCH_ENTRIES];
+    const rvc_entry_t* rvc;
+} batch;
+
+static int32_t batch_entry(uint32_t opcode, uint32_t key, uint32_t fmt) {
+    if (fmt == BATCH_SCALAR) return INST_UNKNOWN | (BATCH_SCALAR << 8);
+
+    // The scalar decoder is the reference: run it on the key bits alone
+    instruction_t decoded;
+    decode_instruction(opcode | ((key & 7) << 12) | ((key >> 3) << 25), &decoded);
+    uint32_t type = decoded.inst_type;
+    uint32_t funct3 = key & 7;
+    if (opcode == OPCODE_OP_IMM && (inst_flags[type] & INST_F_SHAMT)) fmt = BATCH_SHAMT;
+    if (opcode == OPCODE_OP_IMM_32 && (funct3 == 0x1 || funct3 == 0x5)) fmt = BATCH_SHAMT_W;
+    return type | (fmt << 8) | ((inst_flags[type] & INST_F_RD) ? BATCH_RD : 0);
+}
+
+void decode_batch_init(void) {
+    static int ready = 0;
+    if (ready) return;
+
+    // Entry 0: every other opcode (RVC lanes are overridden later)
+    batch.entries[0] = INST_UNKNOWN | (BATCH_I << 8);
+    for (uint32_t opcode = 0; opcode < 128; opcode++) {
+        batch.opcodes[opcode] = 0;
+    }
+    batch.rvc = decode_rvc_table();
+
+    uint32_t used = 1;
+    for (size_t i = 0; i < sizeof(batch_opcodes) / sizeof(batch_opcodes[0]); i++) {
+        uint32_t opcode = batch_opcodes[i].opcode;
+        uint32_t mask = batch_opcodes[i].mask;
+        assert(used + mask + 1 <= BATCH_ENTRIES);
+        for (uint32_t key = 0; key <= mask; key++) {
+            batch.entries[used + key] = batch_entry(opcode, key & mask, batch_opcodes[i].fmt);
+        }
+        batch.opcodes[opcode] = (int32_t)(used | (mask << 16));
+        used += mask + 1;
+    }
+    ready = 1;
+}
+
+#if defined(__AVX2__)
+// The vector path writes bytes 4..11 as two packed words, and RVC entries
+// are the first 8 bytes
+typedef char batch_layout[(offsetof(instruction_t, inst_type) == 4 && offsetof(instruction_t, rs2) == 7 &&
+                           offsetof(instruction_t, rs3) == 8 && offsetof(instruction_t, variant) == 11 &&
+                           sizeof(instruction_t) == 12 && sizeof(rvc_entry_t) == 8 &&
+                           offsetof(rvc_entry_t, inst_type) == 4 && offsetof(rvc_entry_t, rs2) == 7) ? 1 : -1];
+
+// Decode the 8 words at code (4 bytes apart) into out[0], out[2], ..., out[14]
+static void decode_lanes(const uint8_t* code, instruction_t* out) {
+    const __m256i w = _mm256_loadu_si256((const __m256i*)code);
+    const __m256i m3 = _mm256_set1_epi32(0x7);
+    const __m256i m5 = _mm256_set1_epi32(0x1F);
+
+    // Type: opcode descriptor, then the entry for its (funct7, funct3) key
+    __m256i opcode = _mm256_and_si256(w, _mm256_set1_epi32(0x7F));
+    __m256i desc = _mm256_i32gather_epi32(batch.opcodes, opcode, 4);
+    __m256i key = _mm256_or_si256(_mm256_slli_epi32(_mm256_srli_epi32(w, 25), 3),
+                                  _mm256_and_si256(_mm256_srli_epi32(w, 12), m3));
+    key = _mm256_and_si256(key, _mm256_srli_epi32(desc, 16));
+    __m256i index = _mm256_add_epi32(_mm256_and_si256(desc, _mm256_set1_epi32(0xFFFF)), key);
+    __m256i entry = _mm256_i32gather_epi32(batch.entries, index, 4);
+    __m256i fmt = _mm256_and_si256(_mm256_srli_epi32(entry, 8), _mm256_set1_epi32(0xF));
+
+    // Every immediate format, then pick per lane
+    __m256i sign = _mm256_srai_epi32(w, 31);
+    __m256i imm_i = _mm256_srai_epi32(w, 20);
+    __m256i imm_s = _mm256_or_si256(_mm256_andnot_si256(m5, imm_i),
+                                    _mm256_and_si256(_mm256_srli_epi32(w, 7), m5));
+    __m256i imm_b = _mm256_or_si256(
+        _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(0x7E0)),
+                        _mm256_and_si256(_mm256_srli_epi32(w, 7), _mm256_set1_epi32(0x1E))),
+        _mm256_or_si256(_mm256_and_si256(_mm256_slli_epi32(w, 4), _mm256_set1_epi32(0x800)),
+                        _mm256_and_si256(sign, _mm256_set1_epi32((int32_t)0xFFFFF000))));
+    __m256i imm_u = _mm256_and_si256(w, _mm256_set1_epi32((int32_t)0xFFFFF000));
+    __m256i imm_j = _mm256_or_si256(
+        _mm256_or_si256(_mm256_and_si256(w, _mm256_set1_epi32(0xFF000)),
+                        _mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(0x7FE))),
+        _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(w, 9), _mm256_set1_epi32(0x800)),
+                        _mm256_and_si256(sign, _mm256_set1_epi32((int32_t)0xFFF00000))));
+    __m256i shamt = _mm256_and_si256(_mm256_srli_epi32(w, 20), _mm256_set1_epi32(XLEN - 1));
+    __m256i shamt_w = _mm256_and_si256(_mm256_srli_epi32(w, 20), m5);
+
+#define PICK(imm, value, f) imm = _mm256_blendv_epi8(imm, value, _mm256_cmpeq_epi32(fmt, _mm256_set1_epi32(f)))
+    __m256i imm = imm_i;
+    PICK(imm, imm_s, BATCH_S);
+    PICK(imm, imm_b, BATCH_B);
+    PICK(imm, imm_u, BATCH_U);
+    PICK(imm, imm_j, BATCH_J);
+    PICK(imm, shamt, BATCH_SHAMT);
+    PICK(imm, shamt_w, BATCH_SHAMT_W);
+#undef PICK
+
+    // Registers; x0 destinations of rd-writing types go to REG_SINK
+    __m256i rd = _mm256_and_si256(_mm256_srli_epi32(w, 7), m5);
+    __m256i rs1 = _mm256_and_si256(_mm256_srli_epi32(w, 15), m5);
+    __m256i rs2 = _mm256_and_si256(_mm256_srli_epi32(w, 20), m5);
+    __m256i rs3 = _mm256_srli_epi32(w, 27);
+    __m256i writes = _mm256_cmpeq_epi32(_mm256_and_si256(entry, _mm256_set1_epi32(BATCH_RD)),
+                                        _mm256_set1_epi32(BATCH_RD));
+    __m256i sink = _mm256_and_si256(_mm256_cmpeq_epi32(rd, _mm256_setzero_si256()), writes);
+    rd = _mm256_or_si256(rd, _mm256_and_si256(sink, _mm256_set1_epi32(REG_SINK)));
+
+    // Bytes 4..7: inst_type, rd, rs1, rs2. Bytes 8..11: rs3, length 4, pair, variant.
+    __m256i lo = _mm256_or_si256(
+        _mm256_or_si256(_mm256_and_si256(entry, _mm256_set1_epi32(0xFF)), _mm256_slli_epi32(rd, 8)),
+        _mm256_or_si256(_mm256_slli_epi32(rs1, 16), _mm256_slli_epi32(rs2, 24)));
+    __m256i hi = _mm256_or_si256(rs3, _mm256_set1_epi32(4 << 8));
+
+    // RVC lanes (low bits not 11): imm and bytes 4..7 straight from the RVC table
+    __m256i low = _mm256_and_si256(w, _mm256_set1_epi32(0x3));
+    __m256i rvc = _mm256_xor_si256(_mm256_cmpeq_epi32(low, _mm256_set1_epi32(0x3)), _mm256_set1_epi32(-1));
+    __m256i rvc_index = _mm256_or_si256(_mm256_slli_epi32(low, 14),
+                                        _mm256_and_si256(_mm256_srli_epi32(w, 2), _mm256_set1_epi32(0x3FFF)));
+    const int* rvc_words = (const int*)batch.rvc;
+    imm = _mm256_mask_i32gather_epi32(imm, rvc_words, rvc_index, rvc, 8);
+    lo = _mm256_mask_i32gather_epi32(lo, rvc_words + 1, rvc_index, rvc, 8);
+    hi = _mm256_blendv_epi8(hi, _mm256_set1_epi32(2 << 8), rvc);
+
+    int32_t imms[8], los[8], his[8];
+    _mm256_storeu_si256((__m256i*)imms, imm);
+    _mm256_storeu_si256((__m256i*)los, lo);
+    _mm256_storeu_si256((__m256i*)his, hi);
+    for (int k = 0; k < 8; k++) {
+        uint8_t* slot = (uint8_t*)&out[2 * k];
+        memcpy(slot, &imms[k], 4);
+        memcpy(slot + 4, &los[k], 4);
+        memcpy(slot + 8, &his[k], 4);
+    }
+
+    // Lanes the tables do not cover
+    uint32_t scalar = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(
+        _mm256_cmpeq_epi32(fmt, _mm256_set1_epi32(BATCH_SCALAR))));
+    while (scalar) {
+        int k = __builtin_ctz(scalar);
+        scalar &= scalar - 1;
+        uint32_t word;
+        memcpy(&word, code + 4 * k, 4);
+        cpu_decode(word, &out[2 * k]);
+    }
+}
+#endif
+
+void decode_batch(const uint8_t* code, uint32_t count, instruction_t* out) {
+    uint32_t i = 0;
+
+#if defined(__AVX2__)
+    // 16 slots per step: even slots from the words at code + 2i, odd ones
+    // from the words one halfword later
+    for (; i + 16 <= count; i += 16) {
+        decode_lanes(code + 2 * i, &out[i]);
+        decode_lanes(code + 2 * i + 2, &out[i + 1]);
+    }
+#endif
+    for (; i < count; i++) {
+        uint32_t word;
+        memcpy(&word, code + 2 * i, 4);
+        cpu_decode(word, &out[i]);
+    }
+}
@@ -5,21 +5,21 @@
 
 // Decode table entry
 typedef struct {
-    inst_type_t inst_type;
+    uint8_t inst_type;         // inst_type_t
     uint8_t has_imm_override;  // Special immediate handling needed
 } decode_entry_t;
 
-// Decode tables for different opcodes
-extern decode_entry_t op_table[128][8];        // OP instructions (funct7, funct3)
-extern decode_entry_t op_imm_table[128][8];    // OP-IMM instructions (funct7, funct3)
-extern decode_entry_t load_table[8];           // Load instructions (funct3)
-extern decode_entry_t store_table[8];          // Store instructions (funct3)
-extern decode_entry_t branch_table[8];         // Branch instructions (funct3)
-extern decode_entry_t system_table[4096];      // System instructions (funct12)
-extern decode_entry_t amo_table[32][8];        // Atomic instructions (funct5, funct3)
-extern decode_entry_t op_fp_table[128][8];     // FP instructions (funct7, funct3)
+// Decode tables for different opcodes, contiguous so the set stays in L1
+typedef struct {
+    decode_entry_t op[128][8];        // OP instructions (funct7, funct3)
+    decode_entry_t op_imm[128][8];    // OP-IMM instructions (funct7, funct3)
+    decode_entry_t op32[128][8];      // RV64 OP-32 instructions (funct7, funct3)
+    decode_entry_t load[8];           // Load instructions (funct3)
+    decode_entry_t store[8];          // Store instructions (funct3)
+    decode_entry_t branch[8];         // Branch instructions (funct3)
+    decode_entry_t amo[32][8];        // Atomic instructions (funct5, funct3)
+} decode_tables_t;
 
-// Initialize decode tables
-void init_decode_tables(void);
+extern const decode_tables_t decode_tables;
 
-#endif // DECODE_TABLE_H
\ No newline at end of file
+#endif // DECODE_TABLE_H
@@ -0,0 +1,80 @@
+#include "fusion.h"
+
+#define FUSED(name) [INST_FUSED_##name - FUSION_FIRST]
+
+static const char* const fusion_names[FUSION_KINDS] = {
+    FUSED(LI)       = "lui+addi",
+    FUSED(LA)       = "auipc+addi",
+    FUSED(LW_PC)    = "auipc+lw",
+    FUSED(LD_PC)    = "auipc+ld",
+    FUSED(SLLI_ADD) = "slli+add",
+    FUSED(CALL)     = "auipc+jalr",
+    FUSED(ADDI_BNE) = "addi+bne",
+};
+
+const char* fusion_name(uint32_t kind) {
+    return kind < FUSION_KINDS ? fusion_names[kind] : "unknown";
+}
+
+uint32_t fusion_first_type(uint32_t fused_type) {
+    switch (fused_type) {
+        case INST_FUSED_LI:       return INST_LUI;
+        case INST_FUSED_SLLI_ADD: return INST_SLLI;
+        case INST_FUSED_ADDI_BNE: return INST_ADDI;
+        case INST_FUSED_LA:
+        case INST_FUSED_LW_PC:
+        case INST_FUSED_LD_PC:
+        case INST_FUSED_CALL:     return INST_AUIPC;
+    }
+    return fused_type;
+}
+
+// Fused type for first followed by second, or INST_UNKNOWN. Both ops must
+// still run in order, so the pair only has to share the register that
+// links them. A first op writing x0 (REG_SINK) links nothing.
+static uint32_t fusion_match(const instruction_t* first, const instruction_t* second) {
+    uint32_t rd = first->rd;
+    if (rd == REG_SINK) return INST_UNKNOWN;
+    
+    switch (first->inst_type) {
+        case INST_LUI:
+            if (second->inst_type == INST_ADDI && second->rd == rd && second->rs1 == rd) return INST_FUSED_LI;
+            break;
+        case INST_AUIPC:
+            if (second->rs1 != rd) break;
+            if (second->inst_type == INST_ADDI && second->rd == rd) return INST_FUSED_LA;
+            if (second->inst_type == INST_LW) return INST_FUSED_LW_PC;
+#if XLEN == 64
+            if (second->inst_type == INST_LD) return INST_FUSED_LD_PC;
+#endif
+            if (second->inst_type == INST_JALR) return INST_FUSED_CALL;
+            break;
+        case INST_SLLI:
+            if (second->inst_type == INST_ADD && (second->rs1 == rd || second->rs2 == rd)) return INST_FUSED_SLLI_ADD;
+            break;
+        case INST_ADDI:
+            if (second->inst_type == INST_BNE && (second->rs1 == rd || second->rs2 == rd)) return INST_FUSED_ADDI_BNE;
+            break;
+    }
+    return INST_UNKNOWN;
+}
+
+// Fused ops that perform the block's redirect themselves
+static int fusion_ends_block(uint32_t type) {
+    return type == INST_FUSED_CALL || type == INST_FUSED_ADDI_BNE;
+}
+
+void fuse_block(predecoded_t* ops, uint32_t count, uint64_t* sites) {
+    for (uint32_t i = 0; i + 1 < count; i++) {
+        uint32_t type = fusion_match(&ops[i], &ops[i + 1]);
+        if (type == INST_UNKNOWN) continue;
+        // The terminator can only be absorbed by a redirecting pair, and a
+        // straight pair must leave a terminator behind it
+        if (fusion_ends_block(type) != (i + 2 == count)) continue;
+        
+        ops[i].inst_type = type;
+        ops[i].pair = 1;
+        sites[type - FUSION_FIRST]++;
+        i++;
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef FUSION_H
+#define FUSION_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "icache.h"
+
+// Superinstructions: the FUSED_* rows of instructions.def, FUSED_LI..UNKNOWN
+#define FUSION_FIRST INST_FUSED_LI
+#define FUSION_KINDS (INST_UNKNOWN - FUSION_FIRST)
+
+// Rewrite common adjacent pairs in a block's ops into fused ops, counting each
+// fused site in sites[]. A pair that ends the block may only include the
+// terminator when the fused op redirects itself (call, loop branch).
+void fuse_block(predecoded_t* ops, uint32_t count, uint64_t* sites);
+
+// Type of the first op a FUSED_* op was built from
+uint32_t fusion_first_type(uint32_t fused_type);
+
+// Name of a fusion kind (0..FUSION_KINDS-1)
+const char* fusion_name(uint32_t kind);
+
+#endif // FUSION_H
@@ -0,0 +1,163 @@
+#include "icache.h"
+#include "decode.h"
+#include "mmu.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define ICACHE_HASH(base) (((base) >> ICACHE_PAGE_SHIFT) & (ICACHE_BUCKETS - 1))
+
+icache_t* icache_create(void) {
+    decode_batch_init();
+    return calloc(1, sizeof(icache_t));
+}
+
+static void icache_free_list(icache_page_t* page) {
+    while (page) {
+        icache_page_t* next = page->next;
+        free(page);
+        page = next;
+    }
+}
+
+void icache_destroy(icache_t* cache) {
+    if (!cache) return;
+    for (int i = 0; i < ICACHE_BUCKETS; i++) {
+        icache_free_list(cache->buckets[i]);
+    }
+    icache_free_list(cache->retired);
+    free(cache);
+}
+
+static icache_page_t* icache_find(icache_t* cache, reg_t base, uint32_t space) {
+    for (icache_page_t* page = cache->buckets[ICACHE_HASH(base)]; page; page = page->next) {
+        if (page->base == base && page->space == space) return page;
+    }
+    return NULL;
+}
+
+// Unlink a page; it is only recycled on a later miss because the instruction
+// that caused the invalidation may still be executing out of it
+static void icache_retire(icache_t* cache, icache_page_t* page) {
+    icache_page_t** link = &cache->buckets[ICACHE_HASH(page->base)];
+    while (*link != page) link = &(*link)->next;
+    *link = page->next;
+    link = &cache->frames[ICACHE_HASH(page->phys)];
+    while (*link != page) link = &(*link)->phys_next;
+    *link = page->phys_next;
+    page->next = cache->retired;
+    cache->retired = page;
+    if (cache->last == page) cache->last = NULL;
+    cache->invalidations++;
+}
+
+// Predecode the whole page in one batch on first touch. The last slot may
+// hold a 32-bit instruction reaching into the next page and is left for
+// icache_lookup() to decode on demand. phys is the guest physical address
+// base is fetched from.
+static icache_page_t* icache_new_page(icache_t* cache, memory_t* memory, reg_t base, uint64_t phys, uint32_t space) {
+    icache_page_t* page = cache->retired;
+    if (page) {
+        cache->retired = page->next;
+    } else {
+        page = malloc(sizeof(icache_page_t));
+        if (!page) return NULL;
+    }
+    decode_batch(&memory->mem[phys - memory->base], ICACHE_SLOTS - 1, page->slots);
+    page->slots[ICACHE_SLOTS - 1].length = 0;
+    memory_mark_code(memory, phys);
+    cache->pages_decoded++;
+    
+    page->base = base;
+    page->space = space;
+    page->phys = phys;
+    page->next = cache->buckets[ICACHE_HASH(base)];
+    cache->buckets[ICACHE_HASH(base)] = page;
+    page->phys_next = cache->frames[ICACHE_HASH(phys)];
+    cache->frames[ICACHE_HASH(phys)] = page;
+    return page;
+}
+
+predecoded_t* icache_lookup(icache_t* cache, cpu_t* cpu, memory_t* memory, reg_t pc) {
+    reg_t base = pc & ~(reg_t)(ICACHE_PAGE_SIZE - 1);
+    uint32_t space = cpu->mmu.paging[MMU_FETCH];
+    icache_page_t* page = cache->last;
+    
+    if (!page || page->base != base || page->space != space) {
+        page = icache_find(cache, base, space);
+        if (!page) {
+            uint64_t phys;
+            // Translating pc rather than base: PMP may only allow part of the page
+            if (mmu_translate(cpu, memory, pc, MMU_FETCH, &phys)) return NULL;
+            phys -= pc - base;
+            if (!memory_contains(memory, phys, ICACHE_PAGE_SIZE)) return NULL;
+            page = icache_new_page(cache, memory, base, phys, space);
+            if (!page) return NULL;
+        }
+        cache->last = page;
+    }
+    
+    predecoded_t* entry = &page->slots[(pc & (ICACHE_PAGE_SIZE - 1)) >> 1];
+    if (entry->length) {
+        cache->hits++;
+        return entry;
+    }
+    
+    // Miss: fetch and decode once; cpu_decode() also sets length
+    uint32_t instruction;
+    if (!cpu_fetch(cpu, memory, pc, &instruction)) return NULL;
+    cache->misses++;
+    cpu_decode(instruction, entry);
+    
+    // The halves of a 32-bit instruction may come from different physical pages
+    uint64_t phys;
+    mmu_translate(cpu, memory, pc, MMU_FETCH, &phys);
+    memory_mark_code(memory, phys);
+    mmu_translate(cpu, memory, pc + entry->length - 2, MMU_FETCH, &phys);
+    memory_mark_code(memory, phys);
+    
+    // Through translation the next page can be any frame, and a store there
+    // would not find this page, so the op is handed out without keeping it
+    if (page->space && entry->length == 4 && entry == &page->slots[ICACHE_SLOTS - 1]) {
+        cache->crossing = *entry;
+        entry->length = 0;
+        return &cache->crossing;
+    }
+    return entry;
+}
+
+void icache_flush(icache_t* cache) {
+    for (int i = 0; i < ICACHE_BUCKETS; i++) {
+        while (cache->buckets[i]) {
+            icache_retire(cache, cache->buckets[i]);
+        }
+    }
+}
+
+void icache_code_write(void* ctx, uint64_t address) {
+    icache_t* cache = ctx;
+    uint64_t phys = address & ~(uint64_t)(ICACHE_PAGE_SIZE - 1);
+    
+    // Every page decoded from this frame, fetched physically or through any
+    // number of virtual mappings
+    icache_page_t** link = &cache->frames[ICACHE_HASH(phys)];
+    while (*link) {
+        if ((*link)->phys == phys) {
+            icache_retire(cache, *link); // Unlinks it
+        } else {
+            link = &(*link)->phys_next;
+        }
+    }
+    
+    // A 32-bit instruction in the last slot of the previous physical page
+    // reaches into this one; virtual pages never keep such an op
+    if (phys >= ICACHE_PAGE_SIZE) {
+        icache_page_t* prev = icache_find(cache, phys - ICACHE_PAGE_SIZE, 0);
+        if (prev) prev->slots[ICACHE_SLOTS - 1].length = 0;
+    }
+}
+
+void icache_unmap(icache_t* cache, reg_t address) {
+    reg_t base = address & ~(reg_t)(ICACHE_PAGE_SIZE - 1);
+    icache_page_t* page = icache_find(cache, base, 1);
+    if (page) icache_retire(cache, page);
+}
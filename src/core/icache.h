@@ -0,0 +1,56 @@
+#ifndef ICACHE_H
+#define ICACHE_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "jump_table.h"
+
+#define ICACHE_PAGE_SHIFT MEMORY_PAGE_SHIFT
+#define ICACHE_PAGE_SIZE (1u << ICACHE_PAGE_SHIFT)
+#define ICACHE_SLOTS (ICACHE_PAGE_SIZE / 2)   // One slot per halfword (RVC alignment)
+#define ICACHE_BUCKETS 256
+
+// Predecoded instruction: the packed decode result, dispatched through
+// instruction_table[inst_type]. A page is one contiguous array of them, and
+// fused handlers step from an op to the paired one right after it.
+typedef instruction_t predecoded_t;
+
+typedef struct icache_page {
+    reg_t base;                     // Guest address of the page
+    uint32_t space;                 // base is virtual (fetched through translation) or physical
+    uint64_t phys;                  // Guest physical address the page was decoded from
+    struct icache_page* next;       // Hash chain / free list
+    struct icache_page* phys_next;  // Chain in icache_t.frames, for stores into code
+    predecoded_t slots[ICACHE_SLOTS];
+} icache_page_t;
+
+typedef struct icache {
+    icache_page_t* buckets[ICACHE_BUCKETS];
+    icache_page_t* frames[ICACHE_BUCKETS]; // The same pages hashed by phys
+    icache_page_t* last;            // Most recently used page
+    icache_page_t* retired;         // Invalidated pages, reusable once the current instruction is done
+    predecoded_t crossing;          // Last-slot op reaching into another frame, not kept (icache_lookup())
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t pages_decoded;         // Pages predecoded in one batch (decode_batch())
+    uint64_t invalidations;         // Pages dropped by stores into code or FENCE.I
+} icache_t;
+
+icache_t* icache_create(void);
+void icache_destroy(icache_t* cache);
+
+// Predecoded entry for pc as cpu fetches it now, decoding on a miss; NULL if
+// pc cannot be fetched
+predecoded_t* icache_lookup(icache_t* cache, cpu_t* cpu, memory_t* memory, reg_t pc);
+
+// Drop every predecoded page (FENCE.I)
+void icache_flush(icache_t* cache);
+
+// memory_t code-write hook: drop every page decoded from the physical page
+// holding address, under whatever address it was fetched
+void icache_code_write(void* ctx, uint64_t address);
+
+// The virtual page holding address was remapped (SFENCE.VMA): drop it
+void icache_unmap(icache_t* cache, reg_t address);
+
+#endif // ICACHE_H
@@ -0,0 +1,603 @@
+#include "jit.h"
+
+#if JIT_CODE
+
+#include "memory.h"
+#include "fusion.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+// Host registers
+enum { RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+       R8 = 8, R9 = 9, R12 = 12, R13 = 13, R14 = 14, R15 = 15 };
+
+// Pinned while translated code runs (all callee-saved):
+//   rbx = cpu, r12 = memory, r13 = jit, r14 = instret limit,
+//   r15 = memory->mem (memory->window in sandboxed builds)
+#define CPU RBX
+#define MEM R12
+#define JIT R13
+#define END R14
+#define RAM R15
+
+#define W (XLEN == 64)              // Guest registers need REX.W
+#define BLOCK_CODE_MAX (BLOCK_MAX_OPS * 128 + 256)
+
+#define REG_OFF(r) ((int32_t)(offsetof(cpu_t, regs) + (r) * sizeof(reg_t)))
+#define PC_OFF ((int32_t)offsetof(cpu_t, pc))
+#define INSTRET_OFF ((int32_t)offsetof(cpu_t, instret))
+#define EXIT_BLOCK_OFF ((int32_t)offsetof(jit_t, exit_block))
+#define RAM_BASE_OFF ((int32_t)offsetof(memory_t, base))
+#define RAM_SIZE_OFF ((int32_t)offsetof(memory_t, size))
+#if MEMORY_SANDBOX
+#define WINDOW_MASK_OFF ((int32_t)offsetof(memory_t, window_mask))
+#define BLOCKS_OFF ((int32_t)offsetof(cpu_t, blocks))
+#define RUNNING_OFF ((int32_t)offsetof(block_cache_t, running))
+#define RUNNING_INSTRET_OFF ((int32_t)offsetof(block_cache_t, running_instret))
+#endif
+
+typedef struct {
+    uint8_t* p;
+} emit_t;
+
+static void emit8(emit_t* e, uint8_t b) { *e->p++ = b; }
+
+static void emit32(emit_t* e, uint32_t v) {
+    memcpy(e->p, &v, 4);
+    e->p += 4;
+}
+
+static void emit64(emit_t* e, uint64_t v) {
+    memcpy(e->p, &v, 8);
+    e->p += 8;
+}
+
+static void rex(emit_t* e, int w, int reg, int base) {
+    uint8_t b = 0x40 | (w << 3) | ((reg >> 3) << 2) | (base >> 3);
+    if (b != 0x40) emit8(e, b);
+}
+
+// [base + disp32]
+static void modrm_mem(emit_t* e, int reg, int base, int32_t disp) {
+    emit8(e, 0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == RSP) emit8(e, 0x24);
+    emit32(e, (uint32_t)disp);
+}
+
+static void modrm_reg(emit_t* e, int reg, int rm) {
+    emit8(e, 0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+// op r/m, reg  (ADD 01, OR 09, AND 21, SUB 29, XOR 31, CMP 39, MOV 89)
+static void op_rr(emit_t* e, uint8_t op, int w, int dst, int src) {
+    rex(e, w, src, dst);
+    emit8(e, op);
+    modrm_reg(e, src, dst);
+}
+
+// 81 /n id  (ADD 0, OR 1, AND 4, SUB 5, XOR 6, CMP 7)
+static void op_ri(emit_t* e, int n, int w, int dst, int32_t imm) {
+    rex(e, w, 0, dst);
+    emit8(e, 0x81);
+    modrm_reg(e, n, dst);
+    emit32(e, (uint32_t)imm);
+}
+
+static void load_mem(emit_t* e, int w, int reg, int base, int32_t disp) {
+    rex(e, w, reg, base);
+    emit8(e, 0x8B);
+    modrm_mem(e, reg, base, disp);
+}
+
+static void store_mem(emit_t* e, int w, int base, int32_t disp, int reg) {
+    rex(e, w, reg, base);
+    emit8(e, 0x89);
+    modrm_mem(e, reg, base, disp);
+}
+
+// mov reg, imm: zero-extended for 32-bit, sign-extended imm32 or imm64 for 64-bit
+static void mov_ri(emit_t* e, int w, int reg, uint64_t imm) {
+    if (!w || imm <= 0x7FFFFFFF) {
+        rex(e, 0, 0, reg);
+        emit8(e, 0xB8 | (reg & 7));
+        emit32(e, (uint32_t)imm);
+    } else if ((int64_t)imm >= INT32_MIN && (int64_t)imm < 0) {
+        rex(e, 1, 0, reg);
+        emit8(e, 0xC7);
+        modrm_reg(e, 0, reg);
+        emit32(e, (uint32_t)imm);
+    } else {
+        rex(e, 1, 0, reg);
+        emit8(e, 0xB8 | (reg & 7));
+        emit64(e, imm);
+    }
+}
+
+static void guest_load(emit_t* e, int reg, uint32_t r) {
+    if (r == 0) {
+        op_rr(e, 0x31, 0, reg, reg); // xor reg, reg
+    } else {
+        load_mem(e, W, reg, CPU, REG_OFF(r));
+    }
+}
+
+static void guest_store(emit_t* e, uint32_t r, int reg) {
+    store_mem(e, W, CPU, REG_OFF(r), reg);
+}
+
+static void set_pc(emit_t* e, reg_t pc) {
+    if (!W || pc <= 0x7FFFFFFF) {
+        rex(e, W, 0, CPU);                            // mov [rbx + pc], imm32
+        emit8(e, 0xC7);
+        modrm_mem(e, 0, CPU, PC_OFF);
+        emit32(e, (uint32_t)pc);
+        return;
+    }
+    mov_ri(e, W, RAX, pc);
+    store_mem(e, W, CPU, PC_OFF, RAX);
+}
+
+static void call_abs(emit_t* e, const void* fn) {
+    mov_ri(e, 1, RAX, (uint64_t)(uintptr_t)fn);
+    emit8(e, 0xFF);
+    modrm_reg(e, 2, RAX);
+}
+
+// jmp/jcc rel32 with the displacement left for patch_rel32()
+static uint8_t* jmp_rel32(emit_t* e) {
+    emit8(e, 0xE9);
+    uint8_t* slot = e->p;
+    emit32(e, 0);
+    return slot;
+}
+
+static uint8_t* jcc_rel32(emit_t* e, uint8_t cc) {
+    emit8(e, 0x0F);
+    emit8(e, 0x80 | cc);
+    uint8_t* slot = e->p;
+    emit32(e, 0);
+    return slot;
+}
+
+static void patch_rel32(uint8_t* slot, const void* target) {
+    int32_t rel = (int32_t)((const uint8_t*)target - (slot + 4));
+    memcpy(slot, &rel, 4);
+}
+
+// x86 condition codes
+#define CC_B  0x2
+#define CC_AE 0x3
+#define CC_E  0x4
+#define CC_NE 0x5
+#define CC_A  0x7
+#define CC_L  0xC
+#define CC_GE 0xD
+
+// setcc al; movzx eax, al
+static void setcc_eax(emit_t* e, uint8_t cc) {
+    emit8(e, 0x0F); emit8(e, 0x90 | cc); emit8(e, 0xC0);
+    emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0xC0);
+}
+
+// movsxd rax, eax
+static void sext32_rax(emit_t* e) {
+    emit8(e, 0x48); emit8(e, 0x63); emit8(e, 0xC0);
+}
+
+// Shift rax by cl (n = 4 shl, 5 shr, 7 sar) or by an immediate
+static void shift_cl(emit_t* e, int n, int w) {
+    rex(e, w, 0, RAX);
+    emit8(e, 0xD3);
+    modrm_reg(e, n, RAX);
+}
+
+static void shift_imm(emit_t* e, int n, int w, uint8_t amount) {
+    rex(e, w, 0, RAX);
+    emit8(e, 0xC1);
+    modrm_reg(e, n, RAX);
+    emit8(e, amount);
+}
+
+// Address of a load/store in rax: rs1 + imm, zero-extended on RV32
+static void guest_address(emit_t* e, const instruction_t* d) {
+    guest_load(e, RAX, d->rs1);
+    if (d->imm) op_ri(e, 0, W, RAX, d->imm);
+}
+
+// Inline RAM load with a memory_read_slow() call as the out-of-range path
+static void emit_load(emit_t* e, const instruction_t* d) {
+    uint32_t size;
+    switch (d->inst_type) {
+        case INST_LB: case INST_LBU: size = 1; break;
+        case INST_LH: case INST_LHU: size = 2; break;
+#if XLEN == 64
+        case INST_LD: size = 8; break;
+#endif
+        default: size = 4; break;
+    }
+
+    guest_address(e, d);
+#if MEMORY_SANDBOX
+    // No check: the window faults on anything that is not mapped
+    op_rr(e, 0x89, 1, RCX, RAX);                      // rcx = address & memory->window_mask
+    rex(e, 1, RCX, MEM);
+    emit8(e, 0x23);
+    modrm_mem(e, RCX, MEM, WINDOW_MASK_OFF);
+#else
+    op_rr(e, 0x89, 1, RCX, RAX);                      // rcx = address - memory->base
+    load_mem(e, 1, RDX, MEM, RAM_BASE_OFF);
+    op_rr(e, 0x29, 1, RCX, RDX);
+    load_mem(e, 1, RDX, MEM, RAM_SIZE_OFF);           // cmp rcx, memory->size - size
+    op_ri(e, 5, 1, RDX, (int32_t)size);
+    op_rr(e, 0x39, 1, RCX, RDX);
+    uint8_t* to_slow = jcc_rel32(e, CC_A);
+#endif
+    // Fast path: rax = [r15 + rcx], raw
+    switch (size) {
+        case 1: emit8(e, 0x41); emit8(e, 0x0F); emit8(e, 0xB6); emit8(e, 0x04); emit8(e, 0x0F); break;
+        case 2: emit8(e, 0x41); emit8(e, 0x0F); emit8(e, 0xB7); emit8(e, 0x04); emit8(e, 0x0F); break;
+        case 4: emit8(e, 0x41); emit8(e, 0x8B); emit8(e, 0x04); emit8(e, 0x0F); break;
+        case 8: emit8(e, 0x49); emit8(e, 0x8B); emit8(e, 0x04); emit8(e, 0x0F); break;
+    }
+#if !MEMORY_SANDBOX
+    uint8_t* to_done = jmp_rel32(e);
+
+    patch_rel32(to_slow, e->p);                       // rax = memory_read_slow(r12, rax, size), zero-extended
+    op_rr(e, 0x89, 1, RSI, RAX);
+    op_rr(e, 0x89, 1, RDI, MEM);
+    mov_ri(e, 0, RDX, size);
+    call_abs(e, (const void*)memory_read_slow);
+    patch_rel32(to_done, e->p);
+#endif
+
+    // Extend to XLEN
+    switch (d->inst_type) {
+        case INST_LB: emit8(e, 0x48); emit8(e, 0x0F); emit8(e, 0xBE); emit8(e, 0xC0); break;  // movsx rax, al
+        case INST_LH: emit8(e, 0x48); emit8(e, 0x0F); emit8(e, 0xBF); emit8(e, 0xC0); break;  // movsx rax, ax
+        case INST_LW: if (W) sext32_rax(e); break;
+        default: break;
+    }
+    guest_store(e, d->rd, RAX);
+}
+
+// Stores go through memory_write_*() for the code-page check
+static void emit_store(emit_t* e, const instruction_t* d) {
+    const void* fn;
+    switch (d->inst_type) {
+        case INST_SB: fn = (const void*)memory_write_byte; break;
+        case INST_SH: fn = (const void*)memory_write_halfword; break;
+#if XLEN == 64
+        case INST_SD: fn = (const void*)memory_write_doubleword; break;
+#endif
+        default: fn = (const void*)memory_write_word; break;
+    }
+    guest_address(e, d);
+    op_rr(e, 0x89, 1, RSI, RAX);                      // mov rsi, rax
+    guest_load(e, RDX, d->rs2);
+    op_rr(e, 0x89, 1, RDI, MEM);                      // mov rdi, r12
+    call_abs(e, fn);
+}
+
+// Anything without a native translation calls its interpreter handler, from
+// the bare set since translated code only runs with translation off
+static void emit_generic(emit_t* e, const predecoded_t* op, reg_t pc) {
+    set_pc(e, pc);
+    op_rr(e, 0x89, 1, RDI, CPU);
+    op_rr(e, 0x89, 1, RSI, MEM);
+    mov_ri(e, 1, RDX, (uint64_t)(uintptr_t)op);
+    call_abs(e, (const void*)instruction_table_bare[op->inst_type]);
+}
+
+// Straight-line op; returns 0 if it has no native form
+static int emit_native(emit_t* e, const instruction_t* d, uint32_t type, reg_t pc) {
+    if ((inst_flags[type] & INST_F_PURE) && d->rd == REG_SINK) return 1;
+
+    switch (type) {
+        // Register-register ALU: rax = rs1 op rcx
+        case INST_ADD: case INST_SUB: case INST_AND: case INST_OR: case INST_XOR:
+        case INST_SLT: case INST_SLTU: case INST_MUL:
+        case INST_SLL: case INST_SRL: case INST_SRA:
+            guest_load(e, RAX, d->rs1);
+            guest_load(e, RCX, d->rs2);
+            switch (type) {
+                case INST_ADD: op_rr(e, 0x01, W, RAX, RCX); break;
+                case INST_SUB: op_rr(e, 0x29, W, RAX, RCX); break;
+                case INST_AND: op_rr(e, 0x21, W, RAX, RCX); break;
+                case INST_OR:  op_rr(e, 0x09, W, RAX, RCX); break;
+                case INST_XOR: op_rr(e, 0x31, W, RAX, RCX); break;
+                case INST_SLT: op_rr(e, 0x39, W, RAX, RCX); setcc_eax(e, CC_L); break;
+                case INST_SLTU: op_rr(e, 0x39, W, RAX, RCX); setcc_eax(e, CC_B); break;
+                case INST_MUL: rex(e, W, RAX, RCX); emit8(e, 0x0F); emit8(e, 0xAF); modrm_reg(e, RAX, RCX); break;
+                // x86 masks the count to the operand width, as RISC-V does
+                case INST_SLL: shift_cl(e, 4, W); break;
+                case INST_SRL: shift_cl(e, 5, W); break;
+                case INST_SRA: shift_cl(e, 7, W); break;
+            }
+            guest_store(e, d->rd, RAX);
+            return 1;
+
+        // Register-immediate ALU
+        case INST_ADDI: case INST_ANDI: case INST_ORI: case INST_XORI:
+        case INST_SLTI: case INST_SLTIU:
+            guest_load(e, RAX, d->rs1);
+            switch (type) {
+                case INST_ADDI: if (d->imm) op_ri(e, 0, W, RAX, d->imm); break;
+                case INST_ANDI: op_ri(e, 4, W, RAX, d->imm); break;
+                case INST_ORI:  op_ri(e, 1, W, RAX, d->imm); break;
+                case INST_XORI: op_ri(e, 6, W, RAX, d->imm); break;
+                case INST_SLTI: op_ri(e, 7, W, RAX, d->imm); setcc_eax(e, CC_L); break;
+                case INST_SLTIU: op_ri(e, 7, W, RAX, d->imm); setcc_eax(e, CC_B); break;
+            }
+            guest_store(e, d->rd, RAX);
+            return 1;
+        case INST_SLLI: case INST_SRLI: case INST_SRAI:
+            guest_load(e, RAX, d->rs1);
+            shift_imm(e, type == INST_SLLI ? 4 : type == INST_SRLI ? 5 : 7, W, (uint8_t)d->imm);
+            guest_store(e, d->rd, RAX);
+            return 1;
+
+        case INST_LUI:
+            mov_ri(e, W, RAX, (reg_t)(sreg_t)d->imm);
+            guest_store(e, d->rd, RAX);
+            return 1;
+        case INST_AUIPC:
+            mov_ri(e, W, RAX, pc + (sreg_t)d->imm);
+            guest_store(e, d->rd, RAX);
+            return 1;
+
+        case INST_LB: case INST_LBU: case INST_LH: case INST_LHU: case INST_LW:
+#if XLEN == 64
+        case INST_LWU: case INST_LD:
+#endif
+#if MEMORY_SANDBOX
+            set_pc(e, pc);                            // For an access fault
+#endif
+            emit_load(e, d);
+            return 1;
+        case INST_SB: case INST_SH: case INST_SW:
+#if XLEN == 64
+        case INST_SD:
+#endif
+#if MEMORY_SANDBOX
+            set_pc(e, pc);
+#endif
+            emit_store(e, d);
+            return 1;
+
+#if XLEN == 64
+        // 32-bit ops on RV64: compute in eax, sign-extend
+        case INST_ADDIW:
+            guest_load(e, RAX, d->rs1);
+            if (d->imm) op_ri(e, 0, 0, RAX, d->imm);
+            sext32_rax(e);
+            guest_store(e, d->rd, RAX);
+            return 1;
+        case INST_ADDW: case INST_SUBW:
+            guest_load(e, RAX, d->rs1);
+            guest_load(e, RCX, d->rs2);
+            op_rr(e, type == INST_ADDW ? 0x01 : 0x29, 0, RAX, RCX);
+            sext32_rax(e);
+            guest_store(e, d->rd, RAX);
+            return 1;
+        case INST_SLLIW: case INST_SRLIW: case INST_SRAIW:
+            guest_load(e, RAX, d->rs1);
+            shift_imm(e, type == INST_SLLIW ? 4 : type == INST_SRLIW ? 5 : 7, 0, (uint8_t)d->imm);
+            sext32_rax(e);
+            guest_store(e, d->rd, RAX);
+            return 1;
+#endif
+    }
+    return 0;
+}
+
+// Exit to the run loop from block with eax = status (pc already stored)
+static void emit_exit(jit_t* jit, emit_t* e, block_t* block, int status) {
+    mov_ri(e, 1, RAX, (uint64_t)(uintptr_t)block);
+    store_mem(e, 1, JIT, EXIT_BLOCK_OFF, RAX);
+    mov_ri(e, 0, RAX, (uint64_t)status);
+    patch_rel32(jmp_rel32(e), jit->leave);
+}
+
+// Static exit along edge: store pc, then a patchable jump that starts out
+// pointing at an exit stub emitted right after it
+static void emit_edge(jit_t* jit, emit_t* e, block_t* block, int edge) {
+    set_pc(e, block->next_pc[edge]);
+    uint8_t* slot = jmp_rel32(e);
+    patch_rel32(slot, e->p);
+    block->jit_exit[edge] = slot;
+    emit_exit(jit, e, block, 0);
+}
+
+// Instruction a fused op started from; the JIT translates the pair unfused
+static uint32_t unfused_type(const predecoded_t* op) {
+    return op->pair ? fusion_first_type(op->inst_type) : op->inst_type;
+}
+
+int jit_translate(jit_t* jit, block_t* block) {
+    if (jit->used + BLOCK_CODE_MAX > JIT_CODE_SIZE) return 0;
+
+    emit_t emit = { jit->code + jit->used };
+    emit_t* e = &emit;
+    uint8_t* entry = e->p;
+    predecoded_t* last = block->ops + block->count - 1;
+    uint32_t last_type = last->inst_type;
+    int last_native = (last_type >= INST_BEQ && last_type <= INST_JALR) || !block_ends_with(last_type);
+
+    // Entry: stop before crossing the instruction limit, then retire the
+    // block up front (minus a last op the run loop executes)
+    load_mem(e, 1, RAX, CPU, INSTRET_OFF);
+#if MEMORY_SANDBOX
+    // An access fault recounts the block from here (cpu_fault())
+    load_mem(e, 1, RCX, CPU, BLOCKS_OFF);
+    store_mem(e, 1, RCX, RUNNING_INSTRET_OFF, RAX);
+    mov_ri(e, 1, RDX, (uint64_t)(uintptr_t)block);
+    store_mem(e, 1, RCX, RUNNING_OFF, RDX);
+#endif
+    op_ri(e, 0, 1, RAX, (int32_t)block->count);
+    op_rr(e, 0x39, 1, RAX, END);                      // cmp rax, r14
+    uint8_t* to_bail = jcc_rel32(e, CC_A);
+    if (!last_native) op_ri(e, 5, 1, RAX, 1);
+    store_mem(e, 1, CPU, INSTRET_OFF, RAX);
+
+    reg_t pc = block->pc;
+    for (predecoded_t* op = block->ops; op < last; op++) {
+        if (!emit_native(e, op, unfused_type(op), pc)) {
+            emit_generic(e, op, pc);
+        }
+        pc += op->length;
+    }
+
+    // Terminator
+    const instruction_t* d = last;
+    block->jit_exit[0] = NULL;
+    block->jit_exit[1] = NULL;
+    block->jit_linked[0] = NULL;
+    block->jit_linked[1] = NULL;
+    block->jit_target = NULL;
+    if (last_type >= INST_BEQ && last_type <= INST_BGEU) {
+        static const uint8_t branch_cc[] = { CC_E, CC_NE, CC_L, CC_GE, CC_B, CC_AE };
+        guest_load(e, RAX, d->rs1);
+        guest_load(e, RCX, d->rs2);
+        op_rr(e, 0x39, W, RAX, RCX);
+        uint8_t* taken = jcc_rel32(e, branch_cc[last_type - INST_BEQ]);
+        emit_edge(jit, e, block, 0);
+        patch_rel32(taken, e->p);
+        emit_edge(jit, e, block, 1);
+    } else if (last_type == INST_JAL) {
+        if (d->rd != REG_SINK) {
+            mov_ri(e, W, RAX, pc + last->length);
+            guest_store(e, d->rd, RAX);
+        }
+        emit_edge(jit, e, block, 1);
+    } else if (last_type == INST_JALR) {
+        // Target first: rd may be rs1
+        guest_load(e, RAX, d->rs1);
+        if (d->imm) op_ri(e, 0, W, RAX, d->imm);
+        op_ri(e, 4, W, RAX, -2);
+        store_mem(e, W, CPU, PC_OFF, RAX);
+        if (d->rd != REG_SINK) {
+            mov_ri(e, W, RCX, pc + last->length);
+            guest_store(e, d->rd, RCX);
+        }
+        // Inline cache: jump straight to the block linked for next_pc[1]
+        // when the target matches it (both patched by jit_link)
+        rex(e, 1, 0, RCX);                            // mov rcx, imm64
+        emit8(e, 0xB8 | RCX);
+        block->jit_target = e->p;
+        emit64(e, block->next_pc[1]);
+        op_rr(e, 0x39, W, RAX, RCX);
+        uint8_t* miss = jcc_rel32(e, CC_NE);
+        uint8_t* slot = jmp_rel32(e);
+        patch_rel32(slot, e->p);
+        patch_rel32(miss, e->p);
+        block->jit_exit[1] = slot;
+        emit_exit(jit, e, block, 0);
+    } else if (last_native) {
+        // Block cut at a page boundary or BLOCK_MAX_OPS: falls through
+        if (!emit_native(e, d, unfused_type(last), pc)) {
+            emit_generic(e, last, pc);
+        }
+        emit_edge(jit, e, block, 0);
+    } else {
+        // System instructions go back through the run loop's host checks
+        set_pc(e, pc);
+        emit_exit(jit, e, block, 1);
+    }
+
+    // Bail: nothing retired, pc is already the block's address
+    patch_rel32(to_bail, e->p);
+    block->jit_bail = e->p;
+    mov_ri(e, 0, RAX, 0);
+    store_mem(e, 1, JIT, EXIT_BLOCK_OFF, RAX);
+    patch_rel32(jmp_rel32(e), jit->leave);
+
+    jit->used = (size_t)(e->p - jit->code);
+    block->jit_code = entry;
+    jit->translated++;
+    return 1;
+}
+
+void jit_link(jit_t* jit, block_t* prev, block_t* block) {
+    for (int edge = 0; edge < 2; edge++) {
+        if (prev->jit_exit[edge] && prev->jit_linked[edge] != block && prev->next_pc[edge] == block->pc) {
+            if (edge == 1 && prev->jit_target) {
+                // Indirect exits link their first target only: repatching
+                // code that is running costs far more than a run loop trip
+                if (prev->jit_linked[1]) continue;
+                uint64_t target = block->pc;
+                memcpy(prev->jit_target, &target, sizeof(target));
+            }
+            patch_rel32(prev->jit_exit[edge], block->jit_code);
+            prev->jit_linked[edge] = block;
+            jit->links++;
+        }
+    }
+}
+
+void jit_invalidate(block_t* block) {
+    if (!block->jit_code) return;
+    // jmp bail over the entry's instret check
+    uint8_t* entry = (uint8_t*)block->jit_code;
+    entry[0] = 0xE9;
+    patch_rel32(entry + 1, block->jit_bail);
+}
+
+void jit_reset(jit_t* jit) {
+    jit->used = jit->base;
+    jit->exit_block = NULL;
+    jit->resets++;
+}
+
+jit_t* jit_create(void) {
+    jit_t* jit = calloc(1, sizeof(jit_t));
+    if (!jit) return NULL;
+    void* code = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED) {
+        free(jit);
+        return NULL;
+    }
+    jit->code = code;
+
+    // int enter(cpu, memory, jit, end, code)
+    emit_t emit = { jit->code };
+    emit_t* e = &emit;
+    jit->enter = (jit_enter_t)(uintptr_t)e->p;
+    emit8(e, 0x53);                                   // push rbx
+    emit8(e, 0x41); emit8(e, 0x54);                   // push r12
+    emit8(e, 0x41); emit8(e, 0x55);                   // push r13
+    emit8(e, 0x41); emit8(e, 0x56);                   // push r14
+    emit8(e, 0x41); emit8(e, 0x57);                   // push r15 (stack now 16-byte aligned)
+    op_rr(e, 0x89, 1, CPU, RDI);
+    op_rr(e, 0x89, 1, MEM, RSI);
+    op_rr(e, 0x89, 1, JIT, RDX);
+    op_rr(e, 0x89, 1, END, RCX);
+#if MEMORY_SANDBOX
+    load_mem(e, 1, RAM, MEM, (int32_t)offsetof(memory_t, window)); // mov r15, [r12 + window]
+#else
+    load_mem(e, 1, RAM, MEM, (int32_t)offsetof(memory_t, mem)); // mov r15, [r12 + mem]
+#endif
+    rex(e, 0, 0, R8);                                 // jmp r8
+    emit8(e, 0xFF);
+    modrm_reg(e, 4, R8);
+
+    jit->leave = e->p;
+    emit8(e, 0x41); emit8(e, 0x5F);                   // pop r15
+    emit8(e, 0x41); emit8(e, 0x5E);                   // pop r14
+    emit8(e, 0x41); emit8(e, 0x5D);                   // pop r13
+    emit8(e, 0x41); emit8(e, 0x5C);                   // pop r12
+    emit8(e, 0x5B);                                   // pop rbx
+    emit8(e, 0xC3);                                   // ret
+
+    jit->base = jit->used = (size_t)(e->p - jit->code);
+    return jit;
+}
+
+void jit_destroy(jit_t* jit) {
+    if (!jit) return;
+    munmap(jit->code, JIT_CODE_SIZE);
+    free(jit);
+}
+
+#endif // JIT_CODE
@@ -0,0 +1,60 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "cpu.h"
+#include "block_cache.h"
+
+// x86-64 translation of hot basic blocks, selected at build time
+#if JIT_CODE
+
+#if !defined(__x86_64__)
+#error "JIT_CODE needs an x86-64 host"
+#endif
+
+#define JIT_CODE_SIZE (16u << 20)   // Code cache; a full cache flushes the block cache
+
+typedef int (*jit_enter_t)(cpu_t* cpu, memory_t* memory, struct jit* jit, uint64_t end, const void* code);
+
+// Code cache shared by every translated block. Reset together with the block
+// arena, so translated code never outlives the block_t it was built from.
+typedef struct jit {
+    uint8_t* code;              // mmap'd RWX region
+    size_t used;
+    size_t base;                // Bytes taken by the entry/exit stubs
+    jit_enter_t enter;          // Saves host registers and jumps to a block
+    const uint8_t* leave;       // Restores host registers, returns eax
+    block_t* exit_block;        // Block whose exit left the translated code (NULL after a bail)
+    uint64_t translated;
+    uint64_t links;             // Block exits patched into direct jumps
+    uint64_t resets;
+} jit_t;
+
+jit_t* jit_create(void);
+void jit_destroy(jit_t* jit);
+
+// Drop all translated code (block arena reset)
+void jit_reset(jit_t* jit);
+
+// Translate block; 0 if the code cache is full
+int jit_translate(jit_t* jit, block_t* block);
+
+// Patch prev's exits that lead to block (static edges, or the target its
+// indirect jump last took) into direct jumps
+void jit_link(jit_t* jit, block_t* prev, block_t* block);
+
+// Make a translated block bail out to the run loop on entry (code write)
+void jit_invalidate(block_t* block);
+
+// Run translated code from block until an exit that needs the run loop.
+// Translated blocks add their own instructions to cpu->instret and stop
+// before a block that would cross end. Returns 0 with pc at the next block,
+// or 1 with pc on jit->exit_block's last op, which the caller executes.
+static inline int jit_execute(jit_t* jit, cpu_t* cpu, memory_t* memory, block_t* block, uint64_t end) {
+    return jit->enter(cpu, memory, jit, end, block->jit_code);
+}
+
+#endif // JIT_CODE
+
+#endif // JIT_H
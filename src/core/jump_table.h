@@ -3,13 +3,13 @@
 
 #include "cpu.h"
 
-// Function pointer type for instruction execution
-typedef void (*inst_func_t)(cpu_t* cpu, memory_t* memory, instruction_t* decoded, uint32_t instruction);
-
-// Jump table for fast instruction dispatch
-extern inst_func_t instruction_table[INST_UNKNOWN + 1];
-
-// Initialize the jump table
-void init_jump_table(void);
+// Function pointer type for instruction execution; returns the next pc
+typedef reg_t (*inst_func_t)(cpu_t* cpu, memory_t* memory, const instruction_t* decoded);
+
+// Jump tables for fast instruction dispatch, one handler per instruction.
+// instruction_table translates loads and stores; instruction_table_bare is
+// the handler set compiled without translation, valid while mmu_data_bare().
+extern const inst_func_t instruction_table[INST_UNKNOWN + 1];
+extern const inst_func_t instruction_table_bare[INST_UNKNOWN + 1];
 
 #endif // JUMP_TABLE_H
\ No newline at end of file
@@ -0,0 +1,140 @@
+#include "cpu.h"
+#include "icache.h"
+#include "block_cache.h"
+#include "jit.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+// machine_core_t for this XLEN; the build compiles this file once per width
+
+static void* machine_create(const machine_config_t* config) {
+    // The hot header starts on a cache line
+    void* hart;
+    if (posix_memalign(&hart, CPU_CACHE_LINE, sizeof(cpu_t)) != 0) return NULL;
+    cpu_t* cpu = hart;
+    cpu_init(cpu);
+    cpu->pc = (reg_t)config->entry;
+    cpu->fusion = config->fusion;
+    cpu->jit = config->jit;
+    cpu->warm_threshold = config->warm_threshold;
+    cpu->hot_threshold = config->hot_threshold;
+    return cpu;
+}
+
+static void machine_destroy(void* cpu) {
+    if (!cpu) return;
+    cpu_destroy(cpu);
+    free(cpu);
+}
+
+static cpu_exit_t machine_run(void* cpu, memory_t* memory, uint64_t max_instructions) {
+    return cpu_run(cpu, memory, max_instructions);
+}
+
+static void print_result(cpu_t* cpu, uint32_t instruction, memory_t* memory) {
+    uint32_t rd = (instruction >> 7) & 0x1f;
+    uint32_t opcode = instruction & 0x7f;
+
+    printf("--------------------------------\n");
+    // Check if it's a store instruction to show memory state
+    if (opcode == OPCODE_STORE) {
+        uint32_t rs1 = (instruction >> 15) & 0x1f;
+        uint32_t imm = 0;
+        // S-type immediate
+        uint32_t imm11_5 = (instruction >> 25) & 0x7F;
+        uint32_t imm4_0 = (instruction >> 7) & 0x1F;
+        imm = (int32_t)((imm11_5 << 5) | imm4_0);
+        if (imm11_5 & 0x40) imm |= 0xFFFFF000; // Sign extend
+
+        reg_t addr = cpu->regs[rs1] + (sreg_t)(int32_t)imm;
+        if (memory_contains(memory, addr, 4)) printf("Memory at 0x%08llx: %u\n", (unsigned long long)addr, memory_read_word(memory, addr));
+    }
+    else if (rd != 0) {
+        printf("Result: x%d = %llu (0x%llx)\n", rd, (unsigned long long)cpu->regs[rd], (unsigned long long)cpu->regs[rd]);
+    } else {
+        printf("Result: No register change\n");
+    }
+    printf("PC: 0x%08llx\n", (unsigned long long)cpu->pc);
+    printf("Privilege Level: %u\n", cpu->privilege);
+    printf("--------------------------------\n\n");
+}
+
+// Legacy mode: execute and print one instruction at a time
+static cpu_exit_t machine_trace(void* hart, memory_t* memory, uint64_t max_instructions) {
+    cpu_t* cpu = hart;
+    cpu_exit_t reason = CPU_EXIT_LIMIT;
+    for (uint64_t i = 0; max_instructions == 0 || i < max_instructions; i++) {
+        // A fetch the MMU refuses still runs: it takes the fault
+        uint32_t instruction = 0;
+        if (!cpu_fetch(cpu, memory, cpu->pc, &instruction) && !cpu->mmu.translate[MMU_FETCH]) {
+            return CPU_EXIT_FETCH_FAULT;
+        }
+        printf("Test %llu: 0x%08x\n", (unsigned long long)i + 1, instruction);
+        reason = cpu_run(cpu, memory, 1);
+        print_result(cpu, instruction, memory);
+        if (reason != CPU_EXIT_LIMIT) return reason;
+    }
+    return reason;
+}
+
+static void machine_report(void* hart, cpu_exit_t reason, double elapsed) {
+    cpu_t* cpu = hart;
+    printf("Exit: %s at pc 0x%08llx\n", cpu_exit_name(reason), (unsigned long long)cpu->pc);
+    printf("Instructions: %llu in %.3f s (%.2f MIPS)\n", (unsigned long long)cpu->instret, elapsed,
+           elapsed > 0 ? cpu->instret / elapsed / 1e6 : 0.0);
+    printf("Tiers: %llu interpreted, %llu predecoded, %llu translated\n",
+           (unsigned long long)cpu->tier_instret[CPU_TIER_INTERPRET],
+           (unsigned long long)cpu->tier_instret[CPU_TIER_BLOCK],
+           (unsigned long long)cpu->tier_instret[CPU_TIER_JIT]);
+    if (cpu->icache) {
+        icache_t* icache = cpu->icache;
+        printf("Predecode cache: %llu hits, %llu misses, %llu pages batch-decoded, %llu page invalidations\n",
+               (unsigned long long)icache->hits, (unsigned long long)icache->misses,
+               (unsigned long long)icache->pages_decoded, (unsigned long long)icache->invalidations);
+    }
+    if (cpu->blocks) {
+        block_cache_t* blocks = cpu->blocks;
+        printf("Block cache: %llu built, %llu chained transitions, %llu flushes\n",
+               (unsigned long long)blocks->built, (unsigned long long)blocks->chained,
+               (unsigned long long)blocks->flushes);
+        printf("Indirect jumps: %llu returns predicted, %llu inline cache hits, %llu misses\n",
+               (unsigned long long)blocks->ras_hits, (unsigned long long)blocks->ic_hits,
+               (unsigned long long)blocks->ic_misses);
+        for (uint32_t kind = 0; kind < FUSION_KINDS; kind++) {
+            if (!blocks->fused[kind]) continue;
+            printf("Fused %-10s %llu sites, %llu executed\n", fusion_name(kind),
+                   (unsigned long long)blocks->fused[kind], (unsigned long long)blocks->fusion_hits[kind]);
+        }
+#if JIT_CODE
+        if (blocks->jit && blocks->jit->translated) {
+            jit_t* code = blocks->jit;
+            printf("JIT: %llu blocks translated, %zu KB code, %llu direct links, %llu resets\n",
+                   (unsigned long long)code->translated, code->used / 1024,
+                   (unsigned long long)code->links, (unsigned long long)code->resets);
+        }
+#endif
+    }
+    if (cpu->mmu.walks) {
+        printf("MMU: %llu page walks, %llu TLB flushes\n",
+               (unsigned long long)cpu->mmu.walks, (unsigned long long)cpu->mmu.flushes);
+    }
+    printf("Hart: %zu bytes, run loop header %zu bytes in %zu cache lines\n", sizeof(cpu_t),
+           (size_t)CPU_HOT_SIZE, (size_t)(CPU_HOT_SIZE + CPU_CACHE_LINE - 1) / CPU_CACHE_LINE);
+    if (cpu->pmp.rebuilds) {
+        printf("PMP: %llu permission cache rebuilds\n", (unsigned long long)cpu->pmp.rebuilds);
+    }
+    for (int i = 1; i < NUM_REGISTERS; i++) {
+        if (cpu->regs[i] != 0) {
+            printf("x%-2d = 0x%016llx\n", i, (unsigned long long)cpu->regs[i]);
+        }
+    }
+}
+
+const machine_core_t CORE_NAME(machine) = {
+    .xlen = XLEN,
+    .create = machine_create,
+    .destroy = machine_destroy,
+    .run = machine_run,
+    .trace = machine_trace,
+    .report = machine_report,
+};
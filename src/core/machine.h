@@ -0,0 +1,87 @@
+#ifndef MACHINE_H
+#define MACHINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "memory.h"
+
+// Interpreter core: 1 = computed-goto threaded code, 0 = jump table only
+#ifndef THREADED_CODE
+#define THREADED_CODE 0
+#endif
+
+// Translate hot blocks to x86-64 (jit.c): 1 = enabled, 0 = interpret only
+#ifndef JIT_CODE
+#define JIT_CODE 0
+#endif
+
+// Execution tiers: code is interpreted until its block leader has been
+// reached CPU_WARM_THRESHOLD times, then run as a predecoded block, then
+// translated once the block has been entered CPU_HOT_THRESHOLD times
+#define CPU_WARM_THRESHOLD 2
+#define CPU_HOT_THRESHOLD 32
+
+// Width of flat images (hex listings, raw .bin) that carry no ELF class
+#ifndef DEFAULT_XLEN
+#define DEFAULT_XLEN 32
+#endif
+
+// Reasons cpu_run() hands control back to the host
+typedef enum {
+    CPU_EXIT_LIMIT = 0,    // max_instructions retired
+    CPU_EXIT_ECALL,        // ECALL with no trap vector installed (pc left on the ECALL)
+    CPU_EXIT_EBREAK,       // EBREAK with no trap vector installed (pc left on the EBREAK)
+    CPU_EXIT_WFI,          // WFI retired, nothing can wake the hart
+    CPU_EXIT_ILLEGAL,      // Undecodable instruction at pc
+    CPU_EXIT_FETCH_FAULT,  // pc outside guest memory (or not mapped to it, with no trap vector)
+    CPU_EXIT_ACCESS_FAULT, // Load/store outside guest memory with no trap vector (sandboxed builds, page tables)
+    CPU_EXIT_PAGE_FAULT    // Translation failed with no trap vector (pc left on the instruction)
+} cpu_exit_t;
+
+// Host settings for a new hart
+typedef struct {
+    uint64_t entry;             // Initial pc
+    int fusion;                 // Fuse common instruction pairs in blocks
+    int jit;                    // Translate hot blocks in JIT builds
+    uint32_t warm_threshold;    // Leader visits before a block is built
+    uint32_t hot_threshold;     // Block entries before it is translated
+} machine_config_t;
+
+// One instantiation of the core (cpu.c and everything under it is compiled
+// once per XLEN, see core_names.h). The hart is opaque outside the core, so
+// the width is picked once when the machine is created and the handlers
+// never test it.
+typedef struct {
+    int xlen;
+    void* (*create)(const machine_config_t* config); // NULL if out of memory
+    void (*destroy)(void* cpu);
+    cpu_exit_t (*run)(void* cpu, memory_t* memory, uint64_t max_instructions);
+    // Legacy test output: run one instruction at a time, printing each result
+    cpu_exit_t (*trace)(void* cpu, memory_t* memory, uint64_t max_instructions);
+    // Print the exit, retired count, cache statistics and registers
+    void (*report)(void* cpu, cpu_exit_t reason, double elapsed);
+} machine_core_t;
+
+extern const machine_core_t machine_rv32;
+extern const machine_core_t machine_rv64;
+
+// Core for xlen (32 or 64); NULL for any other width
+static inline const machine_core_t* machine_core(int xlen) {
+    return xlen == 64 ? &machine_rv64 : xlen == 32 ? &machine_rv32 : NULL;
+}
+
+static inline const char* cpu_exit_name(cpu_exit_t reason) {
+    switch (reason) {
+        case CPU_EXIT_LIMIT:        return "instruction limit";
+        case CPU_EXIT_ECALL:        return "ecall";
+        case CPU_EXIT_EBREAK:       return "ebreak";
+        case CPU_EXIT_WFI:          return "wfi";
+        case CPU_EXIT_ILLEGAL:      return "illegal instruction";
+        case CPU_EXIT_FETCH_FAULT:  return "fetch fault";
+        case CPU_EXIT_ACCESS_FAULT: return "access fault";
+        case CPU_EXIT_PAGE_FAULT:   return "page fault";
+    }
+    return "unknown";
+}
+
+#endif // MACHINE_H
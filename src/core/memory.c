@@ -1,88 +1,214 @@
 #include "memory.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
 
-void memory_init(memory_t* memory) {
-    for (int i = 0; i < MEMORY_SIZE; i++) {
-        memory->mem[i] = 0;
-    }
+static void* memory_map(uint64_t size) {
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
 }
 
-uint32_t memory_read(memory_t* memory, uint32_t address) {
-    if (address + 3 >= MEMORY_SIZE) {
-        printf("Error: Memory read out of bounds at address 0x%08x\n", address);
-        return 0;
-    }
-    return *(uint32_t*)(memory->mem + address);
+#if MEMORY_SANDBOX
+// Smallest power of two window holding every RV32 address and all of RAM
+static uint64_t memory_window_size(uint64_t end) {
+    uint64_t size = MEMORY_WINDOW_MIN;
+    while (size && size < end) size <<= 1;
+    return size;
 }
 
-void memory_write(memory_t* memory, uint32_t address, uint32_t value) {
-    if (address + 3 >= MEMORY_SIZE) {
-        printf("Error: Memory write out of bounds at address 0x%08x\n", address);
-        return;
+// Flags for every window page (MEMORY_CODE_PAGE)
+#define CODE_PAGES(memory) (((memory)->window_mask >> MEMORY_PAGE_SHIFT) + 1)
+#else
+#define CODE_PAGES(memory) ((memory)->size >> MEMORY_PAGE_SHIFT)
+#endif
+
+int memory_init(memory_t* memory, uint64_t base, uint64_t size, int hugepages) {
+    memory->mem = NULL;
+    memory->code_pages = NULL;
+    memory->code_hook = NULL;
+    memory->code_hook_ctx = NULL;
+    memory->region_count = 0;
+    if (size == 0 || ((base | size) & (MEMORY_PAGE_SIZE - 1)) || base + size < base) return -1;
+
+    memory->base = base;
+    memory->size = size;
+#if MEMORY_SANDBOX
+    // Everything but RAM stays PROT_NONE; the guard page after the window
+    // catches the tail of an access at its last byte
+    uint64_t window = memory_window_size(base + size);
+    if (!window) return -1;
+    void* p = mmap(NULL, window + MEMORY_PAGE_SIZE, PROT_NONE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return -1;
+    memory->window = p;
+    memory->window_mask = window - 1;
+    memory->mem = memory->window + base;
+    memory->code_pages = memory_map(CODE_PAGES(memory));
+    if (!memory->code_pages || mprotect(memory->mem, size, PROT_READ | PROT_WRITE) != 0) {
+        memory_destroy(memory);
+        return -1;
     }
-    *(uint32_t*)(memory->mem + address) = value;
+#else
+    memory->mem = memory_map(size);
+    memory->code_pages = memory_map(CODE_PAGES(memory));
+    if (!memory->mem || !memory->code_pages) {
+        memory_destroy(memory);
+        return -1;
+    }
+#endif
+#ifdef MADV_HUGEPAGE
+    if (hugepages) madvise(memory->mem, size, MADV_HUGEPAGE);
+#else
+    (void)hugepages;
+#endif
+    return 0;
 }
 
-uint8_t memory_read_byte(memory_t* memory, uint32_t address) {
-    if (address >= MEMORY_SIZE) {
-        printf("Error: Memory read byte out of bounds at address 0x%08x\n", address);
-        return 0;
-    }
-    return memory->mem[address];
+void memory_destroy(memory_t* memory) {
+    if (memory->code_pages) munmap(memory->code_pages, CODE_PAGES(memory));
+#if MEMORY_SANDBOX
+    if (memory->mem) munmap(memory->window, memory->window_mask + 1 + MEMORY_PAGE_SIZE);
+    memory->window = NULL;
+#else
+    if (memory->mem) munmap(memory->mem, memory->size);
+    for (uint32_t i = 0; i < memory->region_count; i++) free(memory->regions[i].data);
+#endif
+    memory->mem = NULL;
+    memory->code_pages = NULL;
+    memory->region_count = 0;
 }
 
-uint16_t memory_read_halfword(memory_t* memory, uint32_t address) {
-    if (address + 1 >= MEMORY_SIZE) {
-        printf("Error: Memory read halfword out of bounds at address 0x%08x\n", address);
-        return 0;
-    }
-    return *(uint16_t*)(memory->mem + address);
+static int memory_overlaps(uint64_t base, uint64_t size, uint64_t other_base, uint64_t other_size) {
+    return base < other_base + other_size && other_base < base + size;
 }
 
-uint32_t memory_read_word(memory_t* memory, uint32_t address) {
-    if (address + 3 >= MEMORY_SIZE) {
-        printf("Error: Memory read word out of bounds at address 0x%08x\n", address);
-        return 0;
+static memory_region_t* memory_add_region(memory_t* memory, uint64_t base, uint64_t size) {
+    if (size == 0 || base + size < base || memory->region_count == MEMORY_REGIONS_MAX) return NULL;
+    if (memory_overlaps(base, size, memory->base, memory->size)) return NULL;
+    for (uint32_t i = 0; i < memory->region_count; i++) {
+        if (memory_overlaps(base, size, memory->regions[i].base, memory->regions[i].size)) return NULL;
     }
-    return *(uint32_t*)(memory->mem + address);
+    memory_region_t* region = &memory->regions[memory->region_count];
+    memset(region, 0, sizeof(*region));
+    region->base = base;
+    region->size = size;
+    return region;
 }
 
-void memory_write_byte(memory_t* memory, uint32_t address, uint8_t value) {
-    if (address >= MEMORY_SIZE) {
-        printf("Error: Memory write byte out of bounds at address 0x%08x\n", address);
-        return;
-    }
-    memory->mem[address] = value;
+#if MEMORY_SANDBOX
+int memory_add_rom(memory_t* memory, uint64_t base, const void* data, uint64_t size) {
+    // Whole pages, so the protection cannot spill into a neighbour
+    uint64_t mapped = (size + MEMORY_PAGE_SIZE - 1) & ~(uint64_t)(MEMORY_PAGE_SIZE - 1);
+    if ((base & (MEMORY_PAGE_SIZE - 1)) || mapped < size || base + mapped - 1 > memory->window_mask) return -1;
+    memory_region_t* region = memory_add_region(memory, base, mapped);
+    if (!region) return -1;
+    region->type = MEMORY_REGION_ROM;
+    region->data = memory->window + base;
+    if (mprotect(region->data, mapped, PROT_READ | PROT_WRITE) != 0) return -1;
+    memcpy(region->data, data, size);
+    mprotect(region->data, mapped, PROT_READ);
+    memory->region_count++;
+    return 0;
 }
 
-void memory_write_halfword(memory_t* memory, uint32_t address, uint16_t value) {
-    if (address + 1 >= MEMORY_SIZE) {
-        printf("Error: Memory write halfword out of bounds at address 0x%08x\n", address);
-        return;
+int memory_add_mmio(memory_t* memory, uint64_t base, uint64_t size,
+                    memory_mmio_read_t read, memory_mmio_write_t write, void* ctx) {
+    // Device accesses would fault with nothing to complete them
+    (void)memory; (void)base; (void)size; (void)read; (void)write; (void)ctx;
+    return -1;
+}
+
+int memory_fault_address(const memory_t* memory, const void* host, uint64_t* address) {
+    uint64_t offset = (uint64_t)((uintptr_t)host - (uintptr_t)memory->window);
+    if (!memory->window || offset > memory->window_mask + MEMORY_PAGE_SIZE) return 0;
+    *address = offset;
+    return 1;
+}
+#else
+int memory_add_rom(memory_t* memory, uint64_t base, const void* data, uint64_t size) {
+    memory_region_t* region = memory_add_region(memory, base, size);
+    if (!region) return -1;
+    region->type = MEMORY_REGION_ROM;
+    region->data = malloc(size);
+    if (!region->data) return -1;
+    memcpy(region->data, data, size);
+    memory->region_count++;
+    return 0;
+}
+
+int memory_add_mmio(memory_t* memory, uint64_t base, uint64_t size,
+                    memory_mmio_read_t read, memory_mmio_write_t write, void* ctx) {
+    memory_region_t* region = memory_add_region(memory, base, size);
+    if (!region) return -1;
+    region->type = MEMORY_REGION_MMIO;
+    region->read = read;
+    region->write = write;
+    region->ctx = ctx;
+    memory->region_count++;
+    return 0;
+}
+#endif
+
+void memory_mark_code(memory_t* memory, uint64_t address) {
+    MEMORY_CODE_PAGE(memory, address) = 1;
+}
+
+// Stores into pages holding predecoded code invalidate them (self-modifying code, loaders)
+void memory_code_write(memory_t* memory, uint64_t address, uint32_t size) {
+    uint64_t page = address & ~(uint64_t)(MEMORY_PAGE_SIZE - 1);
+    for (; page < address + size; page += MEMORY_PAGE_SIZE) {
+        if (MEMORY_CODE_PAGE(memory, page)) {
+            MEMORY_CODE_PAGE(memory, page) = 0;
+            if (memory->code_hook) memory->code_hook(memory->code_hook_ctx, page);
+        }
     }
-    *(uint16_t*)(memory->mem + address) = value;
 }
-void memory_write_word(memory_t* memory, uint32_t address, uint32_t value) {
-    if (address + 3 >= MEMORY_SIZE) {
-        printf("Error: Memory write word out of bounds at address 0x%08x\n", address);
-        return;
+
+#if !MEMORY_SANDBOX
+
+static const char* const access_names[9] = {
+    [1] = "byte", [2] = "halfword", [4] = "word", [8] = "doubleword",
+};
+
+// Region holding all size bytes at address, or NULL
+static memory_region_t* memory_find_region(memory_t* memory, uint64_t address, uint32_t size) {
+    for (uint32_t i = 0; i < memory->region_count; i++) {
+        memory_region_t* region = &memory->regions[i];
+        if (region->size >= size && address - region->base <= region->size - size) return region;
     }
-    *(uint32_t*)(memory->mem + address) = value;
+    return NULL;
 }
 
-uint64_t memory_read_doubleword(memory_t* memory, uint32_t address) {
-    if (address + 7 >= MEMORY_SIZE) {
-        printf("Error: Memory read doubleword out of bounds at address 0x%08x\n", address);
+uint64_t memory_read_slow(memory_t* memory, uint64_t address, uint32_t size) {
+    memory_region_t* region = memory_find_region(memory, address, size);
+    if (!region) {
+        printf("Error: Memory read %s out of bounds at address 0x%08llx\n",
+               access_names[size], (unsigned long long)address);
         return 0;
     }
-    return *(uint64_t*)(memory->mem + address);
+    uint64_t offset = address - region->base;
+    uint64_t value = 0;
+    if (region->type == MEMORY_REGION_MMIO) {
+        if (region->read) value = region->read(region->ctx, offset, size);
+        return size == 8 ? value : value & ((1ull << (size * 8)) - 1);
+    }
+    memcpy(&value, region->data + offset, size);
+    return value;
 }
 
-void memory_write_doubleword(memory_t* memory, uint32_t address, uint64_t value) {
-    if (address + 7 >= MEMORY_SIZE) {
-        printf("Error: Memory write doubleword out of bounds at address 0x%08x\n", address);
+void memory_write_slow(memory_t* memory, uint64_t address, uint32_t size, uint64_t value) {
+    memory_region_t* region = memory_find_region(memory, address, size);
+    if (!region) {
+        printf("Error: Memory write %s out of bounds at address 0x%08llx\n",
+               access_names[size], (unsigned long long)address);
+        return;
+    }
+    if (region->type == MEMORY_REGION_MMIO) {
+        if (region->write) region->write(region->ctx, address - region->base, size, value);
         return;
     }
-    *(uint64_t*)(memory->mem + address) = value;
+    printf("Error: Memory write %s to ROM at address 0x%08llx\n", access_names[size], (unsigned long long)address);
 }
 
+#endif // !MEMORY_SANDBOX
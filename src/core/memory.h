@@ -3,22 +3,153 @@
 
 #include <stdint.h>
 
-#define MEMORY_SIZE 0x100000 // 1MB of memory
+#define MEMORY_SIZE_DEFAULT (64u << 20)  // 64MB of RAM unless the machine asks for more
+#define MEMORY_BASE_DEFAULT 0
+#define MEMORY_PAGE_SHIFT 12
+#define MEMORY_PAGE_SIZE (1u << MEMORY_PAGE_SHIFT)
 
+#define MEMORY_REGIONS_MAX 16
+
+// Sandboxed builds put guest physical memory in one reserved host window and
+// let the MMU catch stray accesses instead of bounds-checking each one
+#ifndef MEMORY_SANDBOX
+#define MEMORY_SANDBOX 0
+#endif
+#define MEMORY_WINDOW_MIN (1ull << 32)  // Every RV32 address, zero-extended
+
+// Called when a store lands in a page marked as holding predecoded code
+typedef void (*memory_code_hook_t)(void* ctx, uint64_t address);
+
+// Device callbacks; offset is relative to the region base, size is 1, 2, 4 or 8
+typedef uint64_t (*memory_mmio_read_t)(void* ctx, uint64_t offset, uint32_t size);
+typedef void (*memory_mmio_write_t)(void* ctx, uint64_t offset, uint32_t size, uint64_t value);
+
+typedef enum {
+    MEMORY_REGION_ROM,              // Read-only bytes, stores are dropped
+    MEMORY_REGION_MMIO,             // Every access goes to the device callbacks
+} memory_region_type_t;
+
+// Physical address range outside RAM
 typedef struct {
-    uint8_t mem[MEMORY_SIZE];
+    uint64_t base;
+    uint64_t size;
+    memory_region_type_t type;
+    uint8_t* data;                  // ROM contents
+    memory_mmio_read_t read;
+    memory_mmio_write_t write;
+    void* ctx;
+} memory_region_t;
+
+// Guest RAM is one anonymous mapping: pages are zero-filled by the host on
+// first touch, so setting up any size costs the same. Accesses that miss RAM
+// fall through to a search of the other regions, or in sandboxed builds go
+// straight to the window and fault on anything unmapped.
+typedef struct {
+    uint8_t* mem;                   // Host view of guest RAM
+    uint64_t base;                  // Guest physical address of mem[0]
+    uint64_t size;                  // RAM bytes, a multiple of MEMORY_PAGE_SIZE
+    uint8_t* code_pages;            // Per RAM page: holds predecoded instructions
+    memory_code_hook_t code_hook;
+    void* code_hook_ctx;
+    memory_region_t regions[MEMORY_REGIONS_MAX];
+    uint32_t region_count;
+#if MEMORY_SANDBOX
+    uint8_t* window;                // Host view of guest physical address 0
+    uint64_t window_mask;           // Window size - 1; addresses wrap inside it
+#endif
 } memory_t;
 
-void memory_init(memory_t* memory);
-uint32_t memory_read(memory_t* memory, uint32_t address);
-void memory_write(memory_t* memory, uint32_t address, uint32_t value);
-uint8_t memory_read_byte(memory_t* memory, uint32_t address);
-uint16_t memory_read_halfword(memory_t* memory, uint32_t address);
-uint32_t memory_read_word(memory_t* memory, uint32_t address);
-void memory_write_byte(memory_t* memory, uint32_t address, uint8_t value);
-void memory_write_halfword(memory_t* memory, uint32_t address, uint16_t value);
-void memory_write_word(memory_t* memory, uint32_t address, uint32_t value);
-uint64_t memory_read_doubleword(memory_t* memory, uint32_t address);
-void memory_write_doubleword(memory_t* memory, uint32_t address, uint64_t value);
+// Map size bytes of RAM at guest address base (both page aligned). hugepages
+// asks the host for transparent huge pages. Returns 0, or -1 on failure.
+int memory_init(memory_t* memory, uint64_t base, uint64_t size, int hugepages);
+void memory_destroy(memory_t* memory);
+
+// Attach a region; it may not overlap RAM or another region. Returns 0, or -1.
+// ROM keeps its own copy of data. Sandboxed builds map ROM read-only into the
+// window (base must be page aligned) and have no MMIO.
+int memory_add_rom(memory_t* memory, uint64_t base, const void* data, uint64_t size);
+int memory_add_mmio(memory_t* memory, uint64_t base, uint64_t size,
+                    memory_mmio_read_t read, memory_mmio_write_t write, void* ctx);
+
+#if MEMORY_SANDBOX
+// Guest physical address of a host fault address; 0 if it is not in the window
+int memory_fault_address(const memory_t* memory, const void* host, uint64_t* address);
+#endif
+
+// size bytes at address lie inside RAM
+static inline int memory_contains(const memory_t* memory, uint64_t address, uint64_t size) {
+    return address - memory->base <= memory->size - size;
+}
+
+void memory_mark_code(memory_t* memory, uint64_t address);
+
+// Out-of-line halves of the accessors below
+void memory_code_write(memory_t* memory, uint64_t address, uint32_t size); // Store hit a code page
+#if !MEMORY_SANDBOX
+// Outside RAM: ROM/MMIO regions, else reported and read as 0. Values are zero-extended.
+uint64_t memory_read_slow(memory_t* memory, uint64_t address, uint32_t size);
+void memory_write_slow(memory_t* memory, uint64_t address, uint32_t size, uint64_t value);
+#endif
+
+// Code page flag for address: indexed by window page in sandboxed builds, RAM page otherwise
+#if MEMORY_SANDBOX
+#define MEMORY_CODE_PAGE(memory, address) \
+    ((memory)->code_pages[((address) & (memory)->window_mask) >> MEMORY_PAGE_SHIFT])
+
+static inline uint8_t* memory_host(const memory_t* memory, uint64_t address) {
+    return memory->window + (address & memory->window_mask);
+}
+#else
+#define MEMORY_CODE_PAGE(memory, address) \
+    ((memory)->code_pages[((address) - (memory)->base) >> MEMORY_PAGE_SHIFT])
+#endif
+
+static inline void memory_check_code(memory_t* memory, uint64_t address, uint32_t size) {
+    if (MEMORY_CODE_PAGE(memory, address) | MEMORY_CODE_PAGE(memory, address + size - 1)) {
+        memory_code_write(memory, address, size);
+    }
+}
+
+// Accessors, inlined into every handler. A RAM access is one compare and an
+// indexed host load/store (no compare at all in sandboxed builds, where
+// anything unmapped faults); only stores into code pages and accesses
+// outside RAM leave the inline path. Doublewords are one native 64-bit access.
+#if MEMORY_SANDBOX
+#define MEMORY_ACCESSORS(name, type, size) \
+static inline type memory_read_##name(memory_t* memory, uint64_t address) { \
+    return *(type*)memory_host(memory, address); \
+} \
+static inline void memory_write_##name(memory_t* memory, uint64_t address, type value) { \
+    memory_check_code(memory, address, size); \
+    *(type*)memory_host(memory, address) = value; \
+}
+#else
+#define MEMORY_ACCESSORS(name, type, size) \
+static inline type memory_read_##name(memory_t* memory, uint64_t address) { \
+    if (!memory_contains(memory, address, size)) return (type)memory_read_slow(memory, address, size); \
+    return *(type*)(memory->mem + (address - memory->base)); \
+} \
+static inline void memory_write_##name(memory_t* memory, uint64_t address, type value) { \
+    if (!memory_contains(memory, address, size)) { \
+        memory_write_slow(memory, address, size, value); \
+        return; \
+    } \
+    memory_check_code(memory, address, size); \
+    *(type*)(memory->mem + (address - memory->base)) = value; \
+}
+#endif
+MEMORY_ACCESSORS(byte, uint8_t, 1)
+MEMORY_ACCESSORS(halfword, uint16_t, 2)
+MEMORY_ACCESSORS(word, uint32_t, 4)
+MEMORY_ACCESSORS(doubleword, uint64_t, 8)
+#undef MEMORY_ACCESSORS
+
+static inline uint32_t memory_read(memory_t* memory, uint64_t address) {
+    return memory_read_word(memory, address);
+}
+
+static inline void memory_write(memory_t* memory, uint64_t address, uint32_t value) {
+    memory_write_word(memory, address, value);
+}
 
 #endif // MEMORY_H
@@ -0,0 +1,349 @@
+#include "mmu.h"
+#include "pmp.h"
+#include "icache.h"
+#include "block_cache.h"
+
+// Page table entry bits
+#define PTE_V 0x01
+#define PTE_R 0x02
+#define PTE_W 0x04
+#define PTE_X 0x08
+#define PTE_U 0x10
+#define PTE_G 0x20
+#define PTE_A 0x40
+#define PTE_D 0x80
+
+#if XLEN == 64
+#define PTE_SIZE 8
+#define PTE_VPN_BITS 9
+#define PTE_PPN(pte) (((pte) >> 10) & 0xFFFFFFFFFFFull)
+#define PTE_RESERVED(pte) ((pte) >> 54) // Svpbmt/Svnapot and reserved bits: unsupported
+#else
+#define PTE_SIZE 4
+#define PTE_VPN_BITS 10
+#define PTE_PPN(pte) ((pte) >> 10)
+#define PTE_RESERVED(pte) 0
+#endif
+
+#define PAGE_MASK ((reg_t)(MEMORY_PAGE_SIZE - 1))
+
+static const uint32_t page_fault[MMU_ACCESS_TYPES] = {
+    CAUSE_FETCH_PAGE_FAULT, CAUSE_LOAD_PAGE_FAULT, CAUSE_STORE_PAGE_FAULT,
+};
+static const uint32_t access_fault[MMU_ACCESS_TYPES] = {
+    CAUSE_FETCH_ACCESS, CAUSE_LOAD_ACCESS, CAUSE_STORE_ACCESS,
+};
+static const uint32_t pmp_perm[MMU_ACCESS_TYPES] = {
+    PMP_X, PMP_R, PMP_W,
+};
+
+static void mmu_invalidate(mmu_tlb_entry_t* entry) {
+    entry->tag = MMU_TLB_INVALID;
+    entry->page = MMU_TLB_INVALID;
+}
+
+static void mmu_flush(mmu_t* mmu) {
+    for (int type = 0; type < MMU_ACCESS_TYPES; type++) {
+        for (int i = 0; i < MMU_TLB_SIZE; i++) mmu_invalidate(&mmu->tlb[type][i]);
+    }
+    mmu->flushes++;
+}
+
+// Predecoded code is tagged with virtual addresses while fetches translate
+static void mmu_flush_code(cpu_t* cpu) {
+    if (cpu->icache) icache_flush(cpu->icache);
+    if (cpu->blocks) block_cache_flush(cpu->blocks);
+    cpu->mmu.code_superpages = 0;
+}
+
+void mmu_init(mmu_t* mmu) {
+    mmu->satp = 0;
+    for (int type = 0; type < MMU_ACCESS_TYPES; type++) {
+        mmu->paging[type] = 0;
+        mmu->translate[type] = 0;
+    }
+    mmu->code_superpages = 0;
+    mmu->context = 0;
+    mmu_flush(mmu);
+    mmu->walks = 0;
+    mmu->flushes = 0;
+}
+
+// Privilege loads and stores are checked against: MPP under MPRV in M-mode
+static uint32_t mmu_data_privilege(const cpu_t* cpu) {
+    reg_t status = cpu->csrs[CSR_SLOT_MSTATUS];
+    if (cpu->privilege == MACHINE_MODE && (status & MSTATUS_MPRV)) return (status >> 11) & 0x3;
+    return cpu->privilege;
+}
+
+static uint32_t mmu_privilege(const cpu_t* cpu, mmu_access_t access) {
+    return access == MMU_FETCH ? cpu->privilege : mmu_data_privilege(cpu);
+}
+
+// SUM/MXR (sstatus shares them)
+static uint32_t mmu_status(const cpu_t* cpu) {
+    return cpu->csrs[CSR_SLOT_MSTATUS] & (MSTATUS_SUM | MSTATUS_MXR);
+}
+
+void mmu_update(cpu_t* cpu) {
+    mmu_t* mmu = &cpu->mmu;
+    int on = SATP_MODE(mmu->satp) != SATP_MODE_BARE;
+    uint32_t data = mmu_data_privilege(cpu);
+    mmu->paging[MMU_FETCH] = on && cpu->privilege != MACHINE_MODE;
+    mmu->paging[MMU_LOAD] = on && data != MACHINE_MODE;
+    mmu->paging[MMU_STORE] = mmu->paging[MMU_LOAD];
+    // Untranslated accesses PMP restricts use the TLB too, with identity
+    // entries, so the PMP check is made once per page
+    mmu->translate[MMU_FETCH] = mmu->paging[MMU_FETCH] || pmp_enforced(&cpu->pmp, cpu->privilege);
+    mmu->translate[MMU_LOAD] = mmu->paging[MMU_LOAD] || pmp_enforced(&cpu->pmp, data);
+    mmu->translate[MMU_STORE] = mmu->translate[MMU_LOAD];
+
+    // Entries carry the permission checks of the context they were filled
+    // in. M-mode without MPRV usually uses no TLB, so a trap into it and
+    // back keeps them.
+    uint32_t context = 0;
+    if (mmu->translate[MMU_FETCH]) context |= cpu->privilege + 1;
+    if (mmu->translate[MMU_LOAD]) context |= (data + 1) << 3 | mmu_status(cpu);
+    if (context && context != mmu->context) {
+        if (mmu->context) mmu_flush(mmu);
+        mmu->context = context;
+    }
+}
+
+void mmu_pmp_changed(cpu_t* cpu) {
+    mmu_flush(&cpu->mmu);
+    cpu->mmu.context = 0;
+    mmu_update(cpu);
+}
+
+void mmu_write_satp(cpu_t* cpu, reg_t value) {
+    mmu_t* mmu = &cpu->mmu;
+#if XLEN == 64
+    uint32_t mode = SATP_MODE(value);
+    if (mode != SATP_MODE_BARE && mode != SATP_MODE_SV39 && mode != SATP_MODE_SV48) return;
+#endif
+    if (value == mmu->satp) return;
+
+    // The TLBs and code caches only hold the current address space
+    if (SATP_MODE(mmu->satp) != SATP_MODE_BARE) mmu_flush_code(cpu);
+    mmu->satp = value;
+    mmu_flush(mmu);
+    mmu->context = 0;
+    mmu_update(cpu);
+}
+
+void mmu_fence(cpu_t* cpu, int by_address, reg_t address, int by_asid, reg_t asid) {
+    mmu_t* mmu = &cpu->mmu;
+    // Nothing from another address space is cached
+    if (by_asid && asid != SATP_ASID(mmu->satp)) return;
+    if (!by_address && !by_asid) {
+        mmu_flush(mmu);
+        mmu_flush_code(cpu);
+        return;
+    }
+
+    // Superpages are cached as 4 KiB slices, so fencing an address in one
+    // drops every slice
+    reg_t page = address & ~PAGE_MASK;
+    for (int type = 0; type < MMU_ACCESS_TYPES; type++) {
+        for (int i = 0; i < MMU_TLB_SIZE; i++) {
+            mmu_tlb_entry_t* entry = &mmu->tlb[type][i];
+            if (entry->page == MMU_TLB_INVALID || (by_asid && (entry->flags & MMU_TLB_GLOBAL))) continue;
+            if (!by_address || entry->page == page || (entry->flags & MMU_TLB_SUPERPAGE)) mmu_invalidate(entry);
+        }
+    }
+    if (!by_address || mmu->code_superpages) {
+        mmu_flush_code(cpu);
+    } else {
+        if (cpu->icache) icache_unmap(cpu->icache, page);
+        if (cpu->blocks) block_cache_unmap(cpu->blocks, page);
+    }
+}
+
+// Fill the TLB entry of the virtual page holding address with its frame,
+// once PMP allows the access there
+static uint32_t mmu_fill(cpu_t* cpu, memory_t* memory, reg_t address, uint32_t size, mmu_access_t access,
+                         uint64_t frame, uint32_t flags, uint64_t* phys) {
+    uint32_t privilege = mmu_privilege(cpu, access);
+    uint64_t at = frame | (address & PAGE_MASK);
+    if (pmp_enforced(&cpu->pmp, privilege)) {
+        uint32_t granted = pmp_page(&cpu->pmp, memory, frame, privilege);
+        if (granted & PMP_PAGE_MIXED) {
+            if (!pmp_scan(&cpu->pmp, at, size, pmp_perm[access], privilege)) return access_fault[access];
+            flags |= MMU_TLB_PMP;
+        } else if (!(granted & pmp_perm[access])) {
+            return access_fault[access];
+        }
+    }
+
+    reg_t page = address & ~PAGE_MASK;
+    mmu_tlb_entry_t* entry = &cpu->mmu.tlb[access][MMU_TLB_INDEX(address)];
+    entry->page = page;
+    entry->flags = flags;
+    entry->phys = frame - page;
+    // Only RAM pages have a host view the inline accessors can use, and
+    // only if no access there needs its own PMP check
+    if (memory_contains(memory, frame, MEMORY_PAGE_SIZE) && !(flags & MMU_TLB_PMP)) {
+        entry->tag = page;
+        entry->host = (uintptr_t)(memory->mem + (frame - memory->base)) - page;
+    } else {
+        entry->tag = MMU_TLB_INVALID;
+    }
+    *phys = at;
+    return 0;
+}
+
+// Walk the page table for address and fill its TLB entry. Sets the leaf's
+// A (and for stores D) bit in place, as hardware A/D updating does.
+// Page table accesses are checked by PMP as S-mode ones.
+static uint32_t mmu_walk(cpu_t* cpu, memory_t* memory, reg_t address, uint32_t size, mmu_access_t access,
+                         uint64_t* phys) {
+    mmu_t* mmu = &cpu->mmu;
+#if XLEN == 64
+    int levels = SATP_MODE(mmu->satp) == SATP_MODE_SV48 ? 4 : 3;
+    // Addresses above the VA width must be copies of its top bit
+    int shift = 64 - (MEMORY_PAGE_SHIFT + levels * PTE_VPN_BITS);
+    if ((reg_t)((sreg_t)(address << shift) >> shift) != address) return page_fault[access];
+#else
+    int levels = 2;
+#endif
+    uint32_t privilege = mmu_privilege(cpu, access);
+    uint32_t status = mmu_status(cpu);
+    uint64_t table = (uint64_t)SATP_PPN(mmu->satp) << MEMORY_PAGE_SHIFT;
+    uint32_t flags = 0;
+    mmu->walks++;
+
+    for (int level = levels - 1; level >= 0; level--) {
+        int shift_vpn = level * PTE_VPN_BITS;
+        uint64_t vpn = (address >> (MEMORY_PAGE_SHIFT + shift_vpn)) & ((1u << PTE_VPN_BITS) - 1);
+        uint64_t pte_address = table + vpn * PTE_SIZE;
+        if (!memory_contains(memory, pte_address, PTE_SIZE) ||
+            !pmp_allows(&cpu->pmp, memory, pte_address, PTE_SIZE, PMP_R, SUPERVISOR_MODE)) {
+            return access_fault[access];
+        }
+#if XLEN == 64
+        uint64_t pte = memory_read_doubleword(memory, pte_address);
+#else
+        uint64_t pte = memory_read_word(memory, pte_address);
+#endif
+        if (!(pte & PTE_V) || (!(pte & PTE_R) && (pte & PTE_W)) || PTE_RESERVED(pte)) return page_fault[access];
+        if (pte & PTE_G) flags |= MMU_TLB_GLOBAL;
+        uint64_t ppn = PTE_PPN(pte);
+        if (!(pte & (PTE_R | PTE_X))) {
+            table = ppn << MEMORY_PAGE_SHIFT;
+            continue;
+        }
+
+        // Leaf
+        if (privilege == USER_MODE ? !(pte & PTE_U)
+                                   : (pte & PTE_U) && (access == MMU_FETCH || !(status & MSTATUS_SUM))) {
+            return page_fault[access];
+        }
+        int allowed = access == MMU_FETCH ? (pte & PTE_X) != 0
+                    : access == MMU_LOAD  ? (pte & PTE_R) || ((status & MSTATUS_MXR) && (pte & PTE_X))
+                    : (pte & PTE_W) != 0;
+        if (!allowed) return page_fault[access];
+        uint64_t low = ((uint64_t)1 << shift_vpn) - 1;
+        if (ppn & low) return page_fault[access]; // Misaligned superpage
+
+        uint64_t update = PTE_A | (access == MMU_STORE ? PTE_D : 0);
+        if ((pte & update) != update) {
+            if (!pmp_allows(&cpu->pmp, memory, pte_address, PTE_SIZE, PMP_W, SUPERVISOR_MODE)) {
+                return access_fault[access];
+            }
+#if XLEN == 64
+            memory_write_doubleword(memory, pte_address, pte | update);
+#else
+            memory_write_word(memory, pte_address, (uint32_t)(pte | update));
+#endif
+        }
+        if (level > 0) {
+            flags |= MMU_TLB_SUPERPAGE;
+            if (access == MMU_FETCH) mmu->code_superpages = 1;
+        }
+
+        uint64_t frame = (ppn | ((address >> MEMORY_PAGE_SHIFT) & low)) << MEMORY_PAGE_SHIFT;
+        return mmu_fill(cpu, memory, address, size, access, frame, flags, phys);
+    }
+    return page_fault[access];
+}
+
+// Physical address of an access of size bytes in one page
+static uint32_t mmu_lookup(cpu_t* cpu, memory_t* memory, reg_t address, uint32_t size, mmu_access_t access,
+                           uint64_t* phys) {
+    if (!cpu->mmu.translate[access]) {
+        *phys = address;
+        return 0;
+    }
+    const mmu_tlb_entry_t* entry = &cpu->mmu.tlb[access][MMU_TLB_INDEX(address)];
+    if (entry->page == (address & ~PAGE_MASK)) {
+        *phys = entry->phys + address;
+        if ((entry->flags & MMU_TLB_PMP) &&
+            !pmp_scan(&cpu->pmp, *phys, size, pmp_perm[access], mmu_privilege(cpu, access))) {
+            return access_fault[access];
+        }
+        return 0;
+    }
+    if (!cpu->mmu.paging[access]) {
+        return mmu_fill(cpu, memory, address, size, access, address & ~(uint64_t)PAGE_MASK, 0, phys);
+    }
+    return mmu_walk(cpu, memory, address, size, access, phys);
+}
+
+uint32_t mmu_translate(cpu_t* cpu, memory_t* memory, reg_t address, mmu_access_t access, uint64_t* phys) {
+    return mmu_lookup(cpu, memory, address, 1, access, phys);
+}
+
+// Translate or raise the fault
+static uint64_t mmu_physical(cpu_t* cpu, memory_t* memory, reg_t address, uint32_t size, mmu_access_t access) {
+    uint64_t phys = 0;
+    uint32_t cause = mmu_lookup(cpu, memory, address, size, access, &phys);
+    if (cause) cpu_raise(cpu, cause, address);
+    return phys;
+}
+
+// Bytes of an access of size bytes at address that fit in its page
+static uint32_t mmu_page_part(reg_t address, uint32_t size) {
+    uint32_t left = MEMORY_PAGE_SIZE - (uint32_t)(address & PAGE_MASK);
+    return left < size ? left : size;
+}
+
+uint64_t mmu_read_slow(cpu_t* cpu, memory_t* memory, reg_t address, uint32_t size) {
+    uint32_t part = mmu_page_part(address, size);
+    uint64_t phys = mmu_physical(cpu, memory, address, part, MMU_LOAD);
+    if (part < size) {
+        // Both pages are translated before any byte is read
+        uint64_t next = mmu_physical(cpu, memory, address + part, size - part, MMU_LOAD);
+        uint64_t value = 0;
+        for (uint32_t i = 0; i < size; i++) {
+            uint64_t at = i < part ? phys + i : next + (i - part);
+            value |= (uint64_t)memory_read_byte(memory, at) << (i * 8);
+        }
+        return value;
+    }
+    switch (size) {
+        case 1: return memory_read_byte(memory, phys);
+        case 2: return memory_read_halfword(memory, phys);
+        case 4: return memory_read_word(memory, phys);
+        default: return memory_read_doubleword(memory, phys);
+    }
+}
+
+void mmu_write_slow(cpu_t* cpu, memory_t* memory, reg_t address, uint32_t size, uint64_t value) {
+    uint32_t part = mmu_page_part(address, size);
+    uint64_t phys = mmu_physical(cpu, memory, address, part, MMU_STORE);
+    if (part < size) {
+        uint64_t next = mmu_physical(cpu, memory, address + part, size - part, MMU_STORE);
+        for (uint32_t i = 0; i < size; i++) {
+            uint64_t at = i < part ? phys + i : next + (i - part);
+            memory_write_byte(memory, at, (uint8_t)(value >> (i * 8)));
+        }
+        return;
+    }
+    switch (size) {
+        case 1: memory_write_byte(memory, phys, (uint8_t)value); break;
+        case 2: memory_write_halfword(memory, phys, (uint16_t)value); break;
+        case 4: memory_write_word(memory, phys, (uint32_t)value); break;
+        default: memory_write_doubleword(memory, phys, value); break;
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef MMU_H
+#define MMU_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "memory.h"
+
+// satp.MODE: Sv32 on RV32, Sv39/Sv48 on RV64
+#if XLEN == 64
+#define SATP_MODE(satp) ((uint32_t)((satp) >> 60))
+#define SATP_ASID(satp) (((satp) >> 44) & 0xFFFF)
+#define SATP_PPN(satp)  ((satp) & 0xFFFFFFFFFFFull)
+#else
+#define SATP_MODE(satp) ((uint32_t)((satp) >> 31))
+#define SATP_ASID(satp) (((satp) >> 22) & 0x1FF)
+#define SATP_PPN(satp)  ((satp) & 0x3FFFFF)
+#endif
+#define SATP_MODE_BARE 0
+#define SATP_MODE_SV32 1
+#define SATP_MODE_SV39 8
+#define SATP_MODE_SV48 9
+
+#define MMU_TLB_INDEX(address) (((address) >> MEMORY_PAGE_SHIFT) & (MMU_TLB_SIZE - 1))
+// Tag an access of size bytes has to match: the page, plus any misaligned low
+// bits, so accesses that are misaligned (and may cross a page) miss
+#define MMU_TLB_TAG(address, size) ((address) & ~(reg_t)(MEMORY_PAGE_SIZE - (size)))
+
+// Empty TLBs, no translation (reset)
+void mmu_init(mmu_t* mmu);
+// Recompute which accesses translate after a privilege or mstatus change;
+// entries filled under another privilege or SUM/MXR setting are flushed
+void mmu_update(cpu_t* cpu);
+// satp write; unsupported modes leave it unchanged
+void mmu_write_satp(cpu_t* cpu, reg_t value);
+// PMP CSRs changed: drop TLB entries checked against the old entries
+void mmu_pmp_changed(cpu_t* cpu);
+// SFENCE.VMA for one page (by_address) and/or one ASID (by_asid), else everything
+void mmu_fence(cpu_t* cpu, int by_address, reg_t address, int by_asid, reg_t asid);
+
+// Guest physical address of address for access, through the TLB or a page
+// walk that refills it, checked by PMP. Identity when the access type does
+// not translate. Returns 0, or the page/access fault cause; nothing is raised.
+uint32_t mmu_translate(cpu_t* cpu, memory_t* memory, reg_t address, mmu_access_t access, uint64_t* phys);
+
+// Out-of-line halves of the accessors below: TLB misses, misaligned and
+// page-crossing accesses, and pages outside RAM. Faults are raised.
+uint64_t mmu_read_slow(cpu_t* cpu, memory_t* memory, reg_t address, uint32_t size);
+void mmu_write_slow(cpu_t* cpu, memory_t* memory, reg_t address, uint32_t size, uint64_t value);
+
+// Neither fetches nor data accesses translate (the JIT only runs then)
+static inline int mmu_bare(const cpu_t* cpu) {
+    return !(cpu->mmu.translate[MMU_FETCH] | cpu->mmu.translate[MMU_LOAD]);
+}
+
+// Loads and stores do not translate: satp is Bare, or M-mode without MPRV,
+// and no PMP entry binds the privilege
+static inline int mmu_data_bare(const cpu_t* cpu) {
+    return !cpu->mmu.translate[MMU_LOAD];
+}
+
+// The page holding pc can be fetched from in the current context
+static inline int mmu_fetchable(cpu_t* cpu, memory_t* memory, reg_t pc) {
+    uint64_t phys;
+    const mmu_tlb_entry_t* entry = &cpu->mmu.tlb[MMU_FETCH][MMU_TLB_INDEX(pc)];
+    return (entry->page == (pc & ~(reg_t)(MEMORY_PAGE_SIZE - 1)) && !(entry->flags & MMU_TLB_PMP)) ||
+           mmu_translate(cpu, memory, pc, MMU_FETCH, &phys) == 0;
+}
+
+// Guest loads and stores by virtual address. Without translation they are
+// the memory_*() accessors; with it, a TLB hit is a tag compare and a host
+// access through the cached page pointer (stores also check the physical
+// page for predecoded code).
+#define MMU_ACCESSORS(name, type, size) \
+static inline type mmu_read_##name(cpu_t* cpu, memory_t* memory, reg_t address) { \
+    if (!cpu->mmu.translate[MMU_LOAD]) return memory_read_##name(memory, address); \
+    const mmu_tlb_entry_t* entry = &cpu->mmu.tlb[MMU_LOAD][MMU_TLB_INDEX(address)]; \
+    if (entry->tag != MMU_TLB_TAG(address, size)) return (type)mmu_read_slow(cpu, memory, address, size); \
+    return *(type*)(entry->host + address); \
+} \
+static inline void mmu_write_##name(cpu_t* cpu, memory_t* memory, reg_t address, type value) { \
+    if (!cpu->mmu.translate[MMU_STORE]) { \
+        memory_write_##name(memory, address, value); \
+        return; \
+    } \
+    const mmu_tlb_entry_t* entry = &cpu->mmu.tlb[MMU_STORE][MMU_TLB_INDEX(address)]; \
+    if (entry->tag != MMU_TLB_TAG(address, size)) { \
+        mmu_write_slow(cpu, memory, address, size, value); \
+        return; \
+    } \
+    memory_check_code(memory, entry->phys + address, size); \
+    *(type*)(entry->host + address) = value; \
+}
+MMU_ACCESSORS(byte, uint8_t, 1)
+MMU_ACCESSORS(halfword, uint16_t, 2)
+MMU_ACCESSORS(word, uint32_t, 4)
+MMU_ACCESSORS(doubleword, uint64_t, 8)
+#undef MMU_ACCESSORS
+
+#endif // MMU_H
@@ -0,0 +1,172 @@
+#include "pmp.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if XLEN == 64
+#define PMP_ADDR_MASK 0x3FFFFFFFFFFFFFull // 56-bit physical addresses
+#else
+#define PMP_ADDR_MASK 0xFFFFFFFFu         // 34-bit physical addresses
+#endif
+
+void pmp_init(pmp_t* pmp) {
+    memset(pmp, 0, sizeof(*pmp));
+}
+
+void pmp_destroy(pmp_t* pmp) {
+    free(pmp->pages);
+    pmp->pages = NULL;
+    pmp->page_count = 0;
+}
+
+// Recompute each entry's byte range after a CSR write
+static void pmp_update(pmp_t* pmp) {
+    pmp->active = 0;
+    pmp->locked = 0;
+    for (int n = 0; n < PMP_ENTRIES; n++) {
+        uint64_t addr = pmp->addr[n];
+        uint64_t lo = 0, hi = 0;
+        switch (pmp->cfg[n] & PMP_A) {
+            case PMP_A_TOR:
+                lo = n ? (uint64_t)pmp->addr[n - 1] << 2 : 0;
+                hi = addr << 2;
+                break;
+            case PMP_A_NA4:
+                lo = addr << 2;
+                hi = lo + 4;
+                break;
+            case PMP_A_NAPOT: {
+                uint64_t mask = addr ^ (addr + 1); // Trailing ones and the zero above them
+                lo = (addr & ~mask) << 2;
+                hi = lo + ((mask + 1) << 2);
+                break;
+            }
+            default:
+                break;
+        }
+        pmp->lo[n] = lo;
+        pmp->hi[n] = hi;
+        if (lo < hi) {
+            pmp->active |= 1u << n;
+            if (pmp->cfg[n] & PMP_L) pmp->locked |= 1u << n;
+        }
+    }
+    pmp->pages_stale = 1;
+}
+
+reg_t pmp_read(const pmp_t* pmp, uint32_t csr) {
+    if (csr >= CSR_PMPADDR0) {
+        uint32_t n = csr - CSR_PMPADDR0;
+        return n < PMP_ENTRIES ? pmp->addr[n] : 0;
+    }
+    uint32_t reg = csr - CSR_PMPCFG0;
+#if XLEN == 64
+    if (reg & 1) return 0; // RV64 only has the even pmpcfg registers
+#endif
+    reg_t value = 0;
+    for (uint32_t i = 0; i < sizeof(reg_t) && reg * 4 + i < PMP_ENTRIES; i++) {
+        value |= (reg_t)pmp->cfg[reg * 4 + i] << (i * 8);
+    }
+    return value;
+}
+
+int pmp_write(pmp_t* pmp, uint32_t csr, reg_t value) {
+    int changed = 0;
+    if (csr >= CSR_PMPADDR0) {
+        uint32_t n = csr - CSR_PMPADDR0;
+        if (n >= PMP_ENTRIES || (pmp->cfg[n] & PMP_L)) return 0;
+        // A locked TOR entry also locks the bottom of its range
+        if (n + 1 < PMP_ENTRIES && (pmp->cfg[n + 1] & PMP_L) && (pmp->cfg[n + 1] & PMP_A) == PMP_A_TOR) return 0;
+        value &= PMP_ADDR_MASK;
+        changed = value != pmp->addr[n];
+        pmp->addr[n] = value;
+    } else {
+        uint32_t reg = csr - CSR_PMPCFG0;
+#if XLEN == 64
+        if (reg & 1) return 0;
+#endif
+        for (uint32_t i = 0; i < sizeof(reg_t) && reg * 4 + i < PMP_ENTRIES; i++) {
+            uint8_t* cfg = &pmp->cfg[reg * 4 + i];
+            if (*cfg & PMP_L) continue;
+            uint8_t field = (uint8_t)(value >> (i * 8)) & (PMP_RWX | PMP_A | PMP_L);
+            if ((field & (PMP_R | PMP_W)) == PMP_W) field &= ~PMP_W; // W without R is reserved
+            changed |= field != *cfg;
+            *cfg = field;
+        }
+    }
+    if (changed) pmp_update(pmp);
+    return changed;
+}
+
+// Cache byte for a page entry n covers entirely
+static uint8_t pmp_page_entry(const pmp_t* pmp, int n) {
+    uint8_t granted = pmp->cfg[n] & PMP_RWX;
+    uint8_t machine = (pmp->cfg[n] & PMP_L) ? granted : PMP_RWX;
+    return (uint8_t)(granted | machine << 4);
+}
+
+#define PMP_PAGE_UNMATCHED ((uint8_t)(PMP_RWX << 4)) // Nothing below M, anything in M
+#define PMP_PAGE_SPLIT ((uint8_t)(PMP_PAGE_MIXED | PMP_PAGE_MIXED << 4))
+
+// Cache byte for the page at base: decided by the first entry touching it
+static uint8_t pmp_page_scan(const pmp_t* pmp, uint64_t base) {
+    uint64_t end = base + MEMORY_PAGE_SIZE;
+    for (int n = 0; n < PMP_ENTRIES; n++) {
+        if (!(pmp->active & (1u << n)) || pmp->hi[n] <= base || pmp->lo[n] >= end) continue;
+        if (pmp->lo[n] <= base && pmp->hi[n] >= end) return pmp_page_entry(pmp, n);
+        return PMP_PAGE_SPLIT;
+    }
+    return PMP_PAGE_UNMATCHED;
+}
+
+// Fill the RAM page cache. The first matching entry wins, so entries are
+// painted from the last to the first, each one over the pages it touches.
+static void pmp_rebuild(pmp_t* pmp, const memory_t* memory) {
+    uint64_t count = memory->size >> MEMORY_PAGE_SHIFT;
+    if (pmp->page_count != count) {
+        free(pmp->pages);
+        pmp->pages = malloc(count);
+        pmp->page_count = pmp->pages ? count : 0;
+    }
+    pmp->pages_stale = 0;
+    pmp->rebuilds++;
+    if (!pmp->pages) return; // Every lookup scans instead
+
+    memset(pmp->pages, PMP_PAGE_UNMATCHED, count);
+    for (int n = PMP_ENTRIES - 1; n >= 0; n--) {
+        if (!(pmp->active & (1u << n))) continue;
+        uint64_t lo = pmp->lo[n] > memory->base ? pmp->lo[n] - memory->base : 0;
+        uint64_t hi = pmp->hi[n] > memory->base ? pmp->hi[n] - memory->base : 0;
+        if (hi > memory->size) hi = memory->size;
+        if (lo >= hi) continue;
+        uint64_t first = lo >> MEMORY_PAGE_SHIFT;
+        uint64_t last = (hi - 1) >> MEMORY_PAGE_SHIFT;
+        uint8_t whole = pmp_page_entry(pmp, n);
+        if (first == last) {
+            pmp->pages[first] = (lo & (MEMORY_PAGE_SIZE - 1)) == 0 && (hi - lo) == MEMORY_PAGE_SIZE ? whole : PMP_PAGE_SPLIT;
+            continue;
+        }
+        memset(pmp->pages + first, whole, last - first + 1);
+        if (lo & (MEMORY_PAGE_SIZE - 1)) pmp->pages[first] = PMP_PAGE_SPLIT;
+        if (hi & (MEMORY_PAGE_SIZE - 1)) pmp->pages[last] = PMP_PAGE_SPLIT;
+    }
+}
+
+uint32_t pmp_page(pmp_t* pmp, const memory_t* memory, uint64_t address, uint32_t privilege) {
+    uint32_t shift = privilege == MACHINE_MODE ? 4 : 0;
+    if (memory_contains(memory, address, 1)) {
+        if (pmp->pages_stale) pmp_rebuild(pmp, memory);
+        if (pmp->pages) return (pmp->pages[(address - memory->base) >> MEMORY_PAGE_SHIFT] >> shift) & 0xF;
+    }
+    return (pmp_page_scan(pmp, address & ~(uint64_t)(MEMORY_PAGE_SIZE - 1)) >> shift) & 0xF;
+}
+
+int pmp_scan(const pmp_t* pmp, uint64_t address, uint32_t size, uint32_t perm, uint32_t privilege) {
+    uint64_t end = address + size;
+    for (int n = 0; n < PMP_ENTRIES; n++) {
+        if (!(pmp->active & (1u << n)) || end <= pmp->lo[n] || address >= pmp->hi[n]) continue;
+        if (address < pmp->lo[n] || end > pmp->hi[n]) return 0; // Matching only part of the access fails
+        if (privilege == MACHINE_MODE && !(pmp->cfg[n] & PMP_L)) return 1;
+        return (pmp->cfg[n] & perm) != 0;
+    }
+    return privilege == MACHINE_MODE;
+}
@@ -0,0 +1,56 @@
+#ifndef PMP_H
+#define PMP_H
+
+#include <stdint.h>
+#include "cpu.h"
+#include "memory.h"
+
+// pmpNcfg fields
+#define PMP_R     0x01
+#define PMP_W     0x02
+#define PMP_X     0x04
+#define PMP_A     0x18
+#define PMP_L     0x80
+#define PMP_RWX   (PMP_R | PMP_W | PMP_X)
+
+#define PMP_A_OFF   0x00
+#define PMP_A_TOR   0x08  // Top of range: pmpaddr[N-1] <= address < pmpaddr[N]
+#define PMP_A_NA4   0x10  // Naturally aligned 4 bytes
+#define PMP_A_NAPOT 0x18  // Naturally aligned power of two, size in the trailing ones
+
+// Permission cache nibble: PMP_R/W/X granted for the whole page, or MIXED
+// when entries split it and each access has to be checked on its own
+#define PMP_PAGE_MIXED 0x08
+
+// No entries (reset: PMP does not restrict anything)
+void pmp_init(pmp_t* pmp);
+void pmp_destroy(pmp_t* pmp);
+
+// pmpcfg0-15 and pmpaddr0-63; entries past PMP_ENTRIES read as 0
+reg_t pmp_read(const pmp_t* pmp, uint32_t csr);
+// pmpcfg/pmpaddr write; locked entries ignore it. Returns non-zero if the
+// entries changed, so checks cached elsewhere (the TLBs) are stale.
+int pmp_write(pmp_t* pmp, uint32_t csr, reg_t value);
+
+// Page permissions (PMP_PAGE_* nibble) of the page holding address
+uint32_t pmp_page(pmp_t* pmp, const memory_t* memory, uint64_t address, uint32_t privilege);
+// Every byte of the access matches one entry granting perm (full scan)
+int pmp_scan(const pmp_t* pmp, uint64_t address, uint32_t size, uint32_t perm, uint32_t privilege);
+
+// PMP restricts accesses at privilege. With no active entries nothing is
+// restricted, not even S/U-mode, so programs that never set PMP up still run.
+static inline int pmp_enforced(const pmp_t* pmp, uint32_t privilege) {
+    return privilege == MACHINE_MODE ? pmp->locked != 0 : pmp->active != 0;
+}
+
+// Access of size bytes at physical address is allowed: a cache lookup unless
+// the page is split between entries
+static inline int pmp_allows(pmp_t* pmp, const memory_t* memory, uint64_t address, uint32_t size,
+                             uint32_t perm, uint32_t privilege) {
+    if (!pmp_enforced(pmp, privilege)) return 1;
+    uint32_t granted = pmp_page(pmp, memory, address, privilege);
+    if (granted & PMP_PAGE_MIXED) return pmp_scan(pmp, address, size, perm, privilege);
+    return (granted & perm) != 0;
+}
+
+#endif // PMP_H
@@ -0,0 +1,178 @@
+#include "threaded.h"
+
+#if THREADED_CODE
+
+#if !defined(__GNUC__)
+#error "THREADED_CODE needs GCC/Clang labels-as-values"
+#endif
+
+#include "memory.h"
+#include "mmu.h"
+#include "jump_table.h"
+#include <stddef.h>
+
+#define RD  cpu->regs[op->rd]
+#define RS1 cpu->regs[op->rs1]
+#define RS2 cpu->regs[op->rs2]
+#define IMM ((sreg_t)op->imm)
+
+// Ops carry their type and variant; the label comes from dispatch[][]
+#define DISPATCH() goto *dispatch[op->inst_type][op->variant]
+
+// Straight-line ops cannot redirect, so each one just steps to the next
+#define NEXT() do { cpu->pc += op->length; op++; DISPATCH(); } while (0)
+#define BRANCH(cond) do { cpu->pc += (cond) ? IMM : (sreg_t)op->length; return 0; } while (0)
+
+// Fused pairs: the second op is op[1], and both retire before moving on
+#define PRD  cpu->regs[op[1].rd]
+#define PRS1 cpu->regs[op[1].rs1]
+#define PRS2 cpu->regs[op[1].rs2]
+#define PIMM ((sreg_t)op[1].imm)
+#define NEXT_PAIR() do { cpu->pc += op->length + op[1].length; op += 2; DISPATCH(); } while (0)
+#define FUSION_HIT(name) cpu->blocks->fusion_hits[INST_FUSED_##name - FUSION_FIRST]++
+
+uint8_t threaded_variant(const predecoded_t* op, int last) {
+    if (last) return THREADED_LAST;
+    if ((inst_flags[op->inst_type] & INST_F_PURE) && op->rd == REG_SINK) return THREADED_NOP;
+    return THREADED_OP;
+}
+
+int threaded_execute_block(cpu_t* cpu, memory_t* memory, block_t* block, int bare) {
+    // Link-time constant tables with a row of variants per type: everything
+    // not listed goes through the jump table, and the NOP variant is op_nop.
+    // Memory ops have a label per handler set, like the jump tables.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Woverride-init"
+#define OP(name) [INST_##name][THREADED_OP] = &&op_##name
+#define VM(name) [INST_##name][THREADED_OP] = &&vm_##name
+#define LAST(name) [INST_##name][THREADED_LAST] = &&last_##name
+#define COMMON \
+        [0 ... INST_UNKNOWN] = { \
+            [THREADED_OP] = &&op_generic, \
+            [THREADED_LAST] = &&last_generic, \
+            [THREADED_NOP] = &&op_nop, \
+        }, \
+        OP(ADD), OP(SUB), OP(AND), OP(OR), OP(XOR), \
+        OP(SLL), OP(SRL), OP(SRA), OP(SLT), OP(SLTU), OP(MUL), \
+        OP(ADDI), OP(ANDI), OP(ORI), OP(XORI), OP(SLTI), OP(SLTIU), \
+        OP(SLLI), OP(SRLI), OP(SRAI), OP(LUI), OP(AUIPC), \
+        OP(FUSED_LI), OP(FUSED_LA), OP(FUSED_SLLI_ADD), \
+        OP(FUSED_CALL), OP(FUSED_ADDI_BNE), \
+        LAST(BEQ), LAST(BNE), LAST(BLT), LAST(BGE), LAST(BLTU), LAST(BGEU), \
+        LAST(JAL), LAST(JALR)
+    static const void* const dispatch_bare[INST_UNKNOWN + 1][THREADED_VARIANTS] = {
+        COMMON,
+        OP(LB), OP(LBU), OP(LH), OP(LHU), OP(LW),
+        OP(SB), OP(SH), OP(SW), OP(FUSED_LW_PC),
+    };
+    static const void* const dispatch_vm[INST_UNKNOWN + 1][THREADED_VARIANTS] = {
+        COMMON,
+        VM(LB), VM(LBU), VM(LH), VM(LHU), VM(LW),
+        VM(SB), VM(SH), VM(SW), VM(FUSED_LW_PC),
+    };
+#undef OP
+#undef VM
+#undef LAST
+#undef COMMON
+#pragma GCC diagnostic pop
+    
+    const void* const (*dispatch)[THREADED_VARIANTS] = bare ? dispatch_bare : dispatch_vm;
+    const inst_func_t* handlers = bare ? instruction_table_bare : instruction_table;
+    predecoded_t* op = block->ops;
+    DISPATCH();
+    
+    // ALU
+op_ADD:   RD = RS1 + RS2; NEXT();
+op_SUB:   RD = RS1 - RS2; NEXT();
+op_AND:   RD = RS1 & RS2; NEXT();
+op_OR:    RD = RS1 | RS2; NEXT();
+op_XOR:   RD = RS1 ^ RS2; NEXT();
+op_SLL:   RD = RS1 << (RS2 & (XLEN-1)); NEXT();
+op_SRL:   RD = RS1 >> (RS2 & (XLEN-1)); NEXT();
+op_SRA:   RD = (sreg_t)RS1 >> (RS2 & (XLEN-1)); NEXT();
+op_SLT:   RD = ((sreg_t)RS1 < (sreg_t)RS2) ? 1 : 0; NEXT();
+op_SLTU:  RD = (RS1 < RS2) ? 1 : 0; NEXT();
+op_MUL:   RD = RS1 * RS2; NEXT();
+op_ADDI:  RD = RS1 + IMM; NEXT();
+op_ANDI:  RD = RS1 & IMM; NEXT();
+op_ORI:   RD = RS1 | IMM; NEXT();
+op_XORI:  RD = RS1 ^ IMM; NEXT();
+op_SLTI:  RD = ((sreg_t)RS1 < IMM) ? 1 : 0; NEXT();
+op_SLTIU: RD = (RS1 < (reg_t)IMM) ? 1 : 0; NEXT();
+op_SLLI:  RD = RS1 << op->imm; NEXT();
+op_SRLI:  RD = RS1 >> op->imm; NEXT();
+op_SRAI:  RD = (sreg_t)RS1 >> op->imm; NEXT();
+op_LUI:   RD = IMM; NEXT();
+op_AUIPC: RD = cpu->pc + IMM; NEXT();
+op_nop:   NEXT();
+    
+    // Memory, untranslated
+op_LB:  RD = (sreg_t)(int8_t)memory_read_byte(memory, RS1 + IMM); NEXT();
+op_LBU: RD = memory_read_byte(memory, RS1 + IMM); NEXT();
+op_LH:  RD = (sreg_t)(int16_t)memory_read_halfword(memory, RS1 + IMM); NEXT();
+op_LHU: RD = memory_read_halfword(memory, RS1 + IMM); NEXT();
+op_LW:  RD = (sreg_t)(int32_t)memory_read_word(memory, RS1 + IMM); NEXT();
+op_SB:  memory_write_byte(memory, RS1 + IMM, RS2); NEXT();
+op_SH:  memory_write_halfword(memory, RS1 + IMM, RS2); NEXT();
+op_SW:  memory_write_word(memory, RS1 + IMM, RS2); NEXT();
+    
+    // Memory through the MMU
+vm_LB:  RD = (sreg_t)(int8_t)mmu_read_byte(cpu, memory, RS1 + IMM); NEXT();
+vm_LBU: RD = mmu_read_byte(cpu, memory, RS1 + IMM); NEXT();
+vm_LH:  RD = (sreg_t)(int16_t)mmu_read_halfword(cpu, memory, RS1 + IMM); NEXT();
+vm_LHU: RD = mmu_read_halfword(cpu, memory, RS1 + IMM); NEXT();
+vm_LW:  RD = (sreg_t)(int32_t)mmu_read_word(cpu, memory, RS1 + IMM); NEXT();
+vm_SB:  mmu_write_byte(cpu, memory, RS1 + IMM, RS2); NEXT();
+vm_SH:  mmu_write_halfword(cpu, memory, RS1 + IMM, RS2); NEXT();
+vm_SW:  mmu_write_word(cpu, memory, RS1 + IMM, RS2); NEXT();
+    
+    // Fused pairs
+op_FUSED_LI:       FUSION_HIT(LI); RD = IMM + PIMM; NEXT_PAIR();
+op_FUSED_LA:       FUSION_HIT(LA); RD = cpu->pc + IMM + PIMM; NEXT_PAIR();
+op_FUSED_LW_PC:    FUSION_HIT(LW_PC); RD = cpu->pc + IMM; PRD = (sreg_t)(int32_t)memory_read_word(memory, RD + PIMM); NEXT_PAIR();
+vm_FUSED_LW_PC:    FUSION_HIT(LW_PC); RD = cpu->pc + IMM; PRD = (sreg_t)(int32_t)mmu_read_word(cpu, memory, RD + PIMM); NEXT_PAIR();
+op_FUSED_SLLI_ADD: FUSION_HIT(SLLI_ADD); RD = RS1 << op->imm; PRD = PRS1 + PRS2; NEXT_PAIR();
+op_FUSED_CALL: {
+    FUSION_HIT(CALL);
+    RD = cpu->pc + IMM;
+    reg_t target = (RD + PIMM) & ~(reg_t)1;
+    PRD = cpu->pc + op->length + op[1].length;
+    cpu->pc = target;
+    return 0;
+}
+op_FUSED_ADDI_BNE:
+    FUSION_HIT(ADDI_BNE);
+    RD = RS1 + IMM;
+    cpu->pc += op->length;
+    op++;
+    BRANCH(RS1 != RS2);
+    
+op_generic:
+    cpu->pc = handlers[op->inst_type](cpu, memory, op);
+    op += 1 + op->pair;
+    DISPATCH();
+    
+    // Block terminators
+last_BEQ:  BRANCH(RS1 == RS2);
+last_BNE:  BRANCH(RS1 != RS2);
+last_BLT:  BRANCH((sreg_t)RS1 < (sreg_t)RS2);
+last_BGE:  BRANCH((sreg_t)RS1 >= (sreg_t)RS2);
+last_BLTU: BRANCH(RS1 < RS2);
+last_BGEU: BRANCH(RS1 >= RS2);
+last_JAL: {
+    reg_t link = cpu->pc + op->length;
+    cpu->pc += IMM;
+    RD = link;
+    return 0;
+}
+last_JALR: {
+    reg_t link = cpu->pc + op->length;
+    cpu->pc = (RS1 + IMM) & ~(reg_t)1;
+    RD = link;
+    return 0;
+}
+last_generic:
+    return 1;
+}
+
+#endif // THREADED_CODE
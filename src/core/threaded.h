@@ -0,0 +1,30 @@
+#ifndef THREADED_H
+#define THREADED_H
+
+#include "cpu.h"
+#include "icache.h"
+#include "block_cache.h"
+
+// Computed-goto (labels-as-values) interpreter core, selected at build time
+#if THREADED_CODE
+
+// Dispatch variants: the label table an op jumps through
+enum {
+    THREADED_OP = 0,    // Straight-line op
+    THREADED_LAST,      // Block terminator
+    THREADED_NOP,       // Pure op with rd == x0 (REG_SINK)
+    THREADED_VARIANTS = 4 // Row size of the dispatch table (power of two)
+};
+
+// Dispatch variant for op; last selects the block-terminating one
+uint8_t threaded_variant(const predecoded_t* op, int last);
+
+// Run a block's ops, each jumping straight to the next op's label. Returns 0
+// when the whole block ran (pc is the successor); non-zero leaves pc on the
+// last op for the caller to execute through the generic path. bare selects
+// the handler set without address translation (mmu_data_bare()).
+int threaded_execute_block(cpu_t* cpu, memory_t* memory, block_t* block, int bare);
+
+#endif // THREADED_CODE
+
+#endif // THREADED_H
@@ -1,69 +1,230 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "core/cpu.h"
+#include <time.h>
+#include "core/machine.h"
 #include "core/memory.h"
 
-void print_result(cpu_t* cpu, uint32_t instruction, memory_t* memory) {
-    uint32_t rd = (instruction >> 7) & 0x1f;
-    uint32_t opcode = instruction & 0x7f;
-
-    printf("--------------------------------\n");
-    // Check if it's a store instruction to show memory state
-    if (opcode == OPCODE_STORE) {
-        uint32_t rs1 = (instruction >> 15) & 0x1f;
-        uint32_t rs2 = (instruction >> 20) & 0x1f;
-        uint32_t imm = 0;
-        // S-type immediate
-        uint32_t imm11_5 = (instruction >> 25) & 0x7F;
-        uint32_t imm4_0 = (instruction >> 7) & 0x1F;
-        imm = (int32_t)((imm11_5 << 5) | imm4_0);
-        if (imm11_5 & 0x40) imm |= 0xFFFFF000; // Sign extend
-
-        uint32_t addr = cpu->regs[rs1] + imm;
-        printf("Memory at 0x%08x: %u\n", addr, memory_read_word(memory, addr));
+// Load a hex listing (one instruction word per line, '#' comments) at the start of RAM
+static int load_hex(memory_t* memory, FILE* file) {
+    char line[1024];
+    uint32_t instruction;
+    uint64_t address = memory->base;
+
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (sscanf(line, "%x", &instruction) == 1) {
+            if (!memory_contains(memory, address, 4)) return -1;
+            memory_write_word(memory, address, instruction);
+            address += 4;
+        }
     }
-    else if (rd != 0) {
-        printf("Result: x%d = %u (0x%x)\n", rd, cpu->regs[rd], cpu->regs[rd]);
-    } else {
-        printf("Result: No register change\n");
+    return (int)((address - memory->base) / 4);
+}
+
+// Load a raw binary image at the start of RAM
+static int load_binary(memory_t* memory, FILE* file) {
+    size_t n = fread(memory->mem, 1, memory->size, file);
+    return (int)n;
+}
+
+// Little-endian fields of an ELF header
+static uint64_t elf_field(const uint8_t* p, int size) {
+    uint64_t value = 0;
+    for (int i = size - 1; i >= 0; i--) value = (value << 8) | p[i];
+    return value;
+}
+
+// Load the PT_LOAD segments of a RISC-V ELF at their physical addresses.
+// Returns the XLEN from the ELF class, 0 if the file is not ELF, -1 if it
+// cannot be loaded.
+static int load_elf(memory_t* memory, FILE* file, uint64_t* entry) {
+    uint8_t ehdr[64];
+    size_t n = fread(ehdr, 1, sizeof(ehdr), file);
+    rewind(file);
+    if (n < 52 || memcmp(ehdr, "\x7f" "ELF", 4) != 0) return 0;
+    
+    int elf64 = ehdr[4] == 2;
+    if ((ehdr[4] != 1 && !elf64) || ehdr[5] != 1 || elf_field(ehdr + 18, 2) != 243) return -1; // EM_RISCV, LE
+    if (elf64 && n < 64) return -1;
+    *entry = elf64 ? elf_field(ehdr + 24, 8) : elf_field(ehdr + 24, 4);
+    uint64_t phoff = elf64 ? elf_field(ehdr + 32, 8) : elf_field(ehdr + 28, 4);
+    uint32_t phentsize = (uint32_t)elf_field(ehdr + (elf64 ? 54 : 42), 2);
+    uint32_t phnum = (uint32_t)elf_field(ehdr + (elf64 ? 56 : 44), 2);
+    
+    for (uint32_t i = 0; i < phnum; i++) {
+        uint8_t phdr[56];
+        if (phentsize > sizeof(phdr) || fseek(file, (long)(phoff + (uint64_t)i * phentsize), SEEK_SET) != 0 ||
+            fread(phdr, 1, phentsize, file) != phentsize) {
+            return -1;
+        }
+        if (elf_field(phdr, 4) != 1) continue; // PT_LOAD
+        uint64_t offset = elf64 ? elf_field(phdr + 8, 8) : elf_field(phdr + 4, 4);
+        uint64_t paddr = elf64 ? elf_field(phdr + 24, 8) : elf_field(phdr + 12, 4);
+        uint64_t filesz = elf64 ? elf_field(phdr + 32, 8) : elf_field(phdr + 16, 4);
+        uint64_t memsz = elf64 ? elf_field(phdr + 40, 8) : elf_field(phdr + 20, 4);
+        if (filesz > memsz || (memsz && !memory_contains(memory, paddr, memsz))) return -1;
+        uint8_t* host = memory->mem + (paddr - memory->base);
+        if (fseek(file, (long)offset, SEEK_SET) != 0 || fread(host, 1, filesz, file) != filesz) {
+            return -1;
+        }
+        memset(host + filesz, 0, memsz - filesz);
     }
-    printf("PC: 0x%08x\n", cpu->pc);
-    printf("Privilege Level: %u\n", cpu->privilege);
-    printf("--------------------------------\n\n");
+    return elf64 ? 64 : 32;
 }
 
-int main() {
-    cpu_t cpu;
-    memory_t memory;
-    FILE* file;
-    char line[1024];
-    uint32_t instruction;
-    int test_num = 1;
+// Built-in benchmark: 2M iterations of a call, ALU, load/store and RVC mix
+static const uint32_t bench_program[] = {
+    0x00080137, 0x00010113, 0x00000437, 0x00040413, 0x001e84b7, 0x48048493,
+    0x00040937, 0x00090913, 0x00048513, 0x03c000ef, 0x00a40433, 0x00249293,
+    0x0fc2f293, 0x00590333, 0x00832023, 0x00032383, 0x0079c9b3, 0x00134e03,
+    0x01ca0a33, 0xfff48493, 0xfc0498e3, 0x000008b7, 0x05d88893, 0x00000073,
+    0xff010113, 0x00112623, 0x02a50533, 0x00355593, 0x00b54533, 0x85aa0505,
+    0x208395aa, 0x011300c1, 0x80670101, 0x00000000,
+};
 
-    cpu_init(&cpu);
-    memory_init(&memory);
+static int load_bench(memory_t* memory) {
+    int count = sizeof(bench_program) / sizeof(bench_program[0]);
+    for (int i = 0; i < count; i++) {
+        memory_write_word(memory, memory->base + i * 4, bench_program[i]);
+    }
+    return count;
+}
 
-    file = fopen("instruction.hex", "r");
-    if (!file) {
-        printf("Error: Cannot open instruction.bin\n");
-        return 1;
+// Byte count with an optional K/M/G suffix; 0 if malformed
+static uint64_t parse_size(const char* text) {
+    char* end;
+    uint64_t value = strtoull(text, &end, 0);
+    switch (*end) {
+        case 'K': case 'k': value <<= 10; end++; break;
+        case 'M': case 'm': value <<= 20; end++; break;
+        case 'G': case 'g': value <<= 30; end++; break;
+        default: break;
     }
+    return *end ? 0 : value;
+}
 
-    printf("=== RISC-V Emulator Test ===\n\n");
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
 
-    while (fgets(line, sizeof(line), file)) {
-        if (line[0] == '#' || line[0] == '\n') continue;
-        
-        char* comment = strchr(line, '#');
-        if (sscanf(line, "%x", &instruction) == 1) {
-            printf("Test %d: 0x%08x%s", test_num++, instruction, comment ? comment : "\n");
-            
-            cpu_execute(&cpu, &memory, instruction);
-            print_result(&cpu, instruction, &memory);
+static void usage(const char* prog) {
+    printf("Usage: %s [-t] [-b] [-F] [-J] [-W warm] [-H hot] [-x 32|64] [-m size] [-r base] [-L]\n"
+           "       [-n max_instructions] [program.elf|program.hex|program.bin]\n", prog);
+    printf("  -t  trace every instruction (legacy test output)\n");
+    printf("  -b  run the built-in benchmark instead of a program\n");
+    printf("  -F  disable superinstruction fusion\n");
+    printf("  -J  interpret only, even in a JIT build\n");
+    printf("  -W  leader visits before a block is built (default %d)\n", CPU_WARM_THRESHOLD);
+    printf("  -H  block entries before it is translated (default %d)\n", CPU_HOT_THRESHOLD);
+    printf("  -x  XLEN for hex/bin images and -b (default %d; ELF files use their class)\n", DEFAULT_XLEN);
+    printf("  -m  guest RAM size, K/M/G suffixes allowed (default %uM)\n", MEMORY_SIZE_DEFAULT >> 20);
+    printf("  -r  guest physical address of RAM; hex/bin images load there (default 0x%x)\n", MEMORY_BASE_DEFAULT);
+    printf("  -L  back guest RAM with transparent huge pages\n");
+    printf("  -n  stop after max_instructions (0 = no limit)\n");
+}
+
+int main(int argc, char** argv) {
+    static memory_t memory;
+    const char* path = "instruction.hex";
+    uint64_t max_instructions = 0;
+    int trace = 0;
+    int bench = 0;
+    int xlen = DEFAULT_XLEN;
+    uint64_t ram_base = MEMORY_BASE_DEFAULT;
+    uint64_t ram_size = MEMORY_SIZE_DEFAULT;
+    int hugepages = 0;
+    machine_config_t config = {
+        .entry = 0,
+        .fusion = 1,
+        .jit = 1,
+        .warm_threshold = CPU_WARM_THRESHOLD,
+        .hot_threshold = CPU_HOT_THRESHOLD,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-t") == 0) {
+            trace = 1;
+        } else if (strcmp(argv[i], "-b") == 0) {
+            bench = 1;
+        } else if (strcmp(argv[i], "-F") == 0) {
+            config.fusion = 0;
+        } else if (strcmp(argv[i], "-J") == 0) {
+            config.jit = 0;
+        } else if (strcmp(argv[i], "-W") == 0 && i + 1 < argc) {
+            config.warm_threshold = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-H") == 0 && i + 1 < argc) {
+            config.hot_threshold = strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-x") == 0 && i + 1 < argc && machine_core(atoi(argv[i + 1]))) {
+            xlen = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc && parse_size(argv[i + 1])) {
+            ram_size = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            ram_base = strtoull(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "-L") == 0) {
+            hugepages = 1;
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            max_instructions = strtoull(argv[++i], NULL, 0);
+        } else if (argv[i][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    if (memory_init(&memory, ram_base, ram_size, hugepages) != 0) {
+        printf("Error: Cannot map %llu bytes of guest RAM at 0x%llx\n",
+               (unsigned long long)ram_size, (unsigned long long)ram_base);
+        return 1;
+    }
+    config.entry = ram_base;
+
+    if (bench) {
+        load_bench(&memory);
+    } else {
+        FILE* file = fopen(path, "rb");
+        if (!file) {
+            printf("Error: Cannot open %s\n", path);
+            return 1;
+        }
+        const char* ext = strrchr(path, '.');
+        int loaded = load_elf(&memory, file, &config.entry);
+        if (loaded > 0) {
+            xlen = loaded;
+        } else if (loaded == 0) {
+            loaded = (ext && strcmp(ext, ".bin") == 0) ? load_binary(&memory, file) : load_hex(&memory, file);
+        }
+        fclose(file);
+        if (loaded < 0) {
+            printf("Error: %s does not fit in guest memory\n", path);
+            return 1;
         }
     }
 
-    fclose(file);
+    const machine_core_t* core = machine_core(xlen);
+    if (core->xlen == 32 && ram_base + ram_size > (1ull << 32)) {
+        printf("Error: Guest RAM does not fit the RV32 address space\n");
+        return 1;
+    }
+    void* cpu = core->create(&config);
+    if (!cpu) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+
+    printf("=== RISC-V Emulator (RV%d, %s core%s) ===\n\n", core->xlen, THREADED_CODE ? "threaded" : "jump table",
+           JIT_CODE && config.jit ? ", x86-64 JIT" : "");
+
+    double start = now_seconds();
+    cpu_exit_t reason = trace ? core->trace(cpu, &memory, max_instructions)
+                              : core->run(cpu, &memory, max_instructions);
+    double elapsed = now_seconds() - start;
+
+    core->report(cpu, reason, elapsed);
+    core->destroy(cpu);
+    memory_destroy(&memory);
     return 0;
 }
@@ -0,0 +1,143 @@
+#ifndef TEST_H
+#define TEST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "machine.h"
+#include "memory.h"
+
+// Failed checks so far; each suite reports its own
+extern int test_failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        test_failures++; \
+        printf("  FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+    } \
+} while (0)
+
+// Tier settings a guest program is run under: interpreter only, predecoded
+// blocks (threaded or jump table, as built) with and without fusion, and the
+// JIT translating every block on its first entry
+typedef struct {
+    const char* name;
+    machine_config_t config;
+} test_tier_t;
+
+extern const test_tier_t test_tiers[];
+extern const int test_tier_count;
+
+// Guest RAM for the tests: a small window at 0
+#define TEST_RAM_BASE 0x0
+#define TEST_RAM_SIZE (1u << 20)
+
+// Guest program under construction, one word per instruction
+typedef struct {
+    uint32_t code[1024];
+    uint32_t n;
+} program_t;
+
+static inline uint32_t emit(program_t* p, uint32_t word) {
+    p->code[p->n] = word;
+    return p->n++;
+}
+
+// Branch/jump offset from the instruction emitted next to the one at index target
+#define TO(p, target) ((int32_t)((target) - (p)->n) * 4)
+
+// Called on each fresh memory before test_run() loads the program, to attach
+// devices; NULL for plain RAM
+extern void (*test_attach)(memory_t* memory);
+
+// Load p at TEST_RAM_BASE into a fresh memory and run it on core from there
+cpu_exit_t test_run(const machine_core_t* core, machine_config_t config, const program_t* p,
+                    memory_t* memory, uint64_t max_instructions);
+
+// Registers
+enum {
+    ZERO = 0, RA = 1, SP = 2, T0 = 5, T1 = 6, T2 = 7, S0 = 8, S1 = 9,
+    A0 = 10, A1 = 11, A2 = 12, A3 = 13, A4 = 14, A5 = 15, S2 = 18, S3 = 19, S4 = 20
+};
+
+// Instruction formats
+static inline uint32_t rv_r(uint32_t f7, uint32_t rs2, uint32_t rs1, uint32_t f3, uint32_t rd, uint32_t op) {
+    return f7 << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 | rd << 7 | op;
+}
+static inline uint32_t rv_i(int32_t imm, uint32_t rs1, uint32_t f3, uint32_t rd, uint32_t op) {
+    return ((uint32_t)imm & 0xFFF) << 20 | rs1 << 15 | f3 << 12 | rd << 7 | op;
+}
+static inline uint32_t rv_s(int32_t imm, uint32_t rs2, uint32_t rs1, uint32_t f3, uint32_t op) {
+    uint32_t u = (uint32_t)imm;
+    return ((u >> 5) & 0x7F) << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 | (u & 0x1F) << 7 | op;
+}
+static inline uint32_t rv_b(int32_t off, uint32_t rs2, uint32_t rs1, uint32_t f3) {
+    uint32_t u = (uint32_t)off;
+    return ((u >> 12) & 1) << 31 | ((u >> 5) & 0x3F) << 25 | rs2 << 20 | rs1 << 15 | f3 << 12 |
+           ((u >> 1) & 0xF) << 8 | ((u >> 11) & 1) << 7 | 0x63;
+}
+static inline uint32_t rv_j(int32_t off, uint32_t rd) {
+    uint32_t u = (uint32_t)off;
+    return ((u >> 20) & 1) << 31 | ((u >> 1) & 0x3FF) << 21 | ((u >> 11) & 1) << 20 |
+           ((u >> 12) & 0xFF) << 12 | rd << 7 | 0x6F;
+}
+
+#define LUI(rd, imm20)        ((uint32_t)(imm20) << 12 | (rd) << 7 | 0x37)
+#define AUIPC(rd, imm20)      ((uint32_t)(imm20) << 12 | (rd) << 7 | 0x17)
+#define JAL(rd, off)          rv_j(off, rd)
+#define JALR(rd, rs1, imm)    rv_i(imm, rs1, 0, rd, 0x67)
+#define BEQ(a, b, off)        rv_b(off, b, a, 0)
+#define BNE(a, b, off)        rv_b(off, b, a, 1)
+#define LW(rd, rs1, imm)      rv_i(imm, rs1, 2, rd, 0x03)
+#define LD(rd, rs1, imm)      rv_i(imm, rs1, 3, rd, 0x03)
+#define LBU(rd, rs1, imm)     rv_i(imm, rs1, 4, rd, 0x03)
+#define SW(rs2, rs1, imm)     rv_s(imm, rs2, rs1, 2, 0x23)
+#define ADDI(rd, rs1, imm)    rv_i(imm, rs1, 0, rd, 0x13)
+#define SLTI(rd, rs1, imm)    rv_i(imm, rs1, 2, rd, 0x13)
+#define XORI(rd, rs1, imm)    rv_i(imm, rs1, 4, rd, 0x13)
+#define SLLI(rd, rs1, sh)     rv_i(sh, rs1, 1, rd, 0x13)
+#define SRAI(rd, rs1, sh)     rv_i(0x400 | (sh), rs1, 5, rd, 0x13)
+#define ADD(rd, a, b)         rv_r(0x00, b, a, 0, rd, 0x33)
+#define SUB(rd, a, b)         rv_r(0x20, b, a, 0, rd, 0x33)
+#define OR(rd, a, b)          rv_r(0x00, b, a, 6, rd, 0x33)
+#define SLTU(rd, a, b)        rv_r(0x00, b, a, 3, rd, 0x33)
+#define MUL(rd, a, b)         rv_r(0x01, b, a, 0, rd, 0x33)
+#define MULHU(rd, a, b)       rv_r(0x01, b, a, 3, rd, 0x33)
+#define DIV(rd, a, b)         rv_r(0x01, b, a, 4, rd, 0x33)
+#define REMU(rd, a, b)        rv_r(0x01, b, a, 7, rd, 0x33)
+#define ADDIW(rd, rs1, imm)   rv_i(imm, rs1, 0, rd, 0x1B)
+#define ADDW(rd, a, b)        rv_r(0x00, b, a, 0, rd, 0x3B)
+#define MULW(rd, a, b)        rv_r(0x01, b, a, 0, rd, 0x3B)
+#define CSRRW(rd, csr, rs1)   rv_i(csr, rs1, 1, rd, 0x73)
+#define CSRRS(rd, csr, rs1)   rv_i(csr, rs1, 2, rd, 0x73)
+#define CSRRWI(rd, csr, uimm) rv_i(csr, uimm, 5, rd, 0x73)
+#define CSRRCI(rd, csr, uimm) rv_i(csr, uimm, 7, rd, 0x73)
+#define LR_W(rd, rs1)         rv_r(0x02 << 2, 0, rs1, 2, rd, 0x2F)
+#define SC_W(rd, rs2, rs1)    rv_r(0x03 << 2, rs2, rs1, 2, rd, 0x2F)
+#define AMOADD_W(rd, rs2, rs1) rv_r(0x00 << 2, rs2, rs1, 2, rd, 0x2F)
+#define AMOSWAP_W(rd, rs2, rs1) rv_r(0x01 << 2, rs2, rs1, 2, rd, 0x2F)
+#define AMOADD_D(rd, rs2, rs1) rv_r(0x00 << 2, rs2, rs1, 3, rd, 0x2F)
+#define FMV_W_X(fd, rs1)      rv_r(0x78, 0, rs1, 0, fd, 0x53)
+#define FMV_X_W(rd, fs1)      rv_r(0x70, 0, fs1, 0, rd, 0x53)
+#define FEQ_S(rd, a, b)       rv_r(0x50, b, a, 2, rd, 0x53)
+#define FCVT_W_S(rd, fs1)     rv_r(0x60, 0, fs1, 0, rd, 0x53)
+// CSRs the tests touch
+#define CSR_SATP     0x180
+#define CSR_MSTATUS  0x300
+#define CSR_MSCRATCH 0x340
+#define CSR_MTVEC    0x305
+#define CSR_MEPC     0x341
+#define CSR_MINSTRET 0xB02
+
+#define MRET                  0x30200073u
+#define ECALL                 0x00000073u
+
+// Load a 32-bit constant into rd (lui + addi, which the block tier fuses)
+static inline void emit_li(program_t* p, uint32_t rd, uint32_t value) {
+    uint32_t hi = (value + 0x800) >> 12;
+    emit(p, LUI(rd, hi & 0xFFFFF));
+    emit(p, ADDI(rd, rd, (int32_t)(value << 20) >> 20));
+}
+
+#endif // TEST_H
@@ -0,0 +1,129 @@
+#include "test.h"
+
+// Stores into code under translation. S-mode calls two functions, rewrites
+// them through a second, data-only mapping of their frames halfway through,
+// and calls them again. Everything decoded from a written frame must be
+// dropped, whichever virtual page it was fetched through. The second
+// function's first op crosses a page end, and only the frame after it is
+// rewritten.
+
+#define TABLES 0x10000      // Root table, then the next levels a page apart
+#define FUNCTION 0x2000     // addi a0, a0, 1; ret
+#define CROSSING 0x3FFE     // The same, with the addi across the page end
+#define ALIAS 0x8000        // Maps the frame of FUNCTION
+#define ALIAS_CROSSING 0x9000 // ... and the one CROSSING's addi ends in
+#define RESULT 0x5000
+#define ITERATIONS 64
+
+#define PTE_DATA 0xC7       // V R W A D
+#define PTE_CODE 0xCF       // V R W X A D
+
+// Store value at address (before translation is on)
+static void emit_store(program_t* p, uint32_t address, uint32_t value) {
+    emit_li(p, T0, address);
+    emit_li(p, T1, value);
+    emit(p, SW(T1, T0, 0));
+}
+
+// Page tables mapping virtual pages 0-7 to themselves and the aliases to the
+// frames they rewrite, and satp in T2
+static void emit_tables(program_t* p, int xlen) {
+    uint32_t pte = xlen / 8;
+    uint32_t leaves = TABLES + 0x1000;
+    if (xlen == 64) {
+        emit_store(p, TABLES, ((TABLES + 0x2000) >> 12) << 10 | 1);   // Sv39: root, middle, leaves
+        emit_store(p, TABLES + 0x2000, (leaves >> 12) << 10 | 1);
+    } else {
+        emit_store(p, TABLES, (leaves >> 12) << 10 | 1);
+    }
+    for (uint32_t page = 0; page < 8; page++) {
+        emit_store(p, leaves + page * pte, page << 10 | PTE_CODE);
+    }
+    emit_store(p, leaves + (ALIAS >> 12) * pte, (FUNCTION >> 12) << 10 | PTE_DATA);
+    emit_store(p, leaves + (ALIAS_CROSSING >> 12) * pte, ((CROSSING + 2) >> 12) << 10 | PTE_DATA);
+    if (xlen == 64) {
+        emit(p, ADDI(T2, ZERO, 8));
+        emit(p, SLLI(T2, T2, 60));
+        emit(p, ADDI(T2, T2, TABLES >> 12));
+    } else {
+        emit_li(p, T2, 0x80000000u | TABLES >> 12);
+    }
+}
+
+// The two functions with increment step, as words at FUNCTION and from
+// CROSSING - 2 (an RVC nop first)
+static void emit_functions(program_t* p, int32_t step) {
+    uint32_t addi = ADDI(A0, A0, step);
+    uint32_t ret = JALR(ZERO, RA, 0);
+    emit_store(p, FUNCTION, addi);
+    emit_store(p, FUNCTION + 4, ret);
+    emit_store(p, CROSSING - 2, (addi & 0xFFFF) << 16 | 0x0001);
+    emit_store(p, CROSSING + 2, addi >> 16 | (ret & 0xFFFF) << 16);
+    emit_store(p, CROSSING + 6, ret >> 16);
+}
+
+static void build(program_t* p, int xlen) {
+    p->n = 0;
+    emit_functions(p, 1);
+    emit_tables(p, xlen);
+    emit(p, CSRRW(ZERO, CSR_SATP, T2));
+    emit_li(p, T0, 0x800);              // mstatus.MPP = S
+    emit(p, CSRRW(ZERO, CSR_MSTATUS, T0));
+    emit(p, AUIPC(T0, 0));
+    emit(p, ADDI(T0, T0, 16));
+    emit(p, CSRRW(ZERO, CSR_MEPC, T0));
+    emit(p, MRET);
+
+    // S-mode, fetching through the identity mapping
+    emit_li(p, S2, ITERATIONS);
+    emit(p, ADDI(S3, ZERO, 0));
+    emit(p, ADDI(S4, ZERO, 0));
+    uint32_t loop = p->n;
+    emit(p, ADDI(T0, ZERO, ITERATIONS / 2));
+    uint32_t skip = emit(p, 0);
+    uint32_t addi = ADDI(A0, A0, 2);
+    emit_li(p, T2, ALIAS);
+    emit_li(p, T1, addi);
+    emit(p, SW(T1, T2, 0));
+    emit_li(p, T2, ALIAS_CROSSING);
+    emit_li(p, T1, addi >> 16 | (JALR(ZERO, RA, 0) & 0xFFFF) << 16);
+    emit(p, SW(T1, T2, 0));
+    p->code[skip] = BNE(S2, T0, (int32_t)(p->n - skip) * 4);
+
+    emit(p, ADDI(A0, ZERO, 0));
+    emit(p, JAL(RA, (int32_t)FUNCTION - (int32_t)(p->n * 4)));
+    emit(p, ADD(S3, S3, A0));
+    emit(p, ADDI(A0, ZERO, 0));
+    emit(p, JAL(RA, (int32_t)CROSSING - (int32_t)(p->n * 4)));
+    emit(p, ADD(S4, S4, A0));
+    emit(p, ADDI(S2, S2, -1));
+    emit(p, BNE(S2, ZERO, TO(p, loop)));
+
+    emit_li(p, T0, RESULT);
+    emit(p, SW(S3, T0, 0));
+    emit(p, SW(S4, T0, 4));
+    emit(p, ECALL);
+}
+
+void test_code_write(void) {
+    static program_t program;
+    // Each function adds 1 until the rewrite, then 2
+    uint32_t expected = ITERATIONS / 2 * 1 + ITERATIONS / 2 * 2;
+    for (int xlen = 32; xlen <= 64; xlen += 32) {
+        const machine_core_t* core = machine_core(xlen);
+        build(&program, xlen);
+        for (int t = 0; t < test_tier_count; t++) {
+            memory_t memory;
+            cpu_exit_t reason = test_run(core, test_tiers[t].config, &program, &memory, 1000000);
+            const char* tier = test_tiers[t].name;
+            uint32_t function = memory_read_word(&memory, TEST_RAM_BASE + RESULT);
+            uint32_t crossing = memory_read_word(&memory, TEST_RAM_BASE + RESULT + 4);
+            CHECK(reason == CPU_EXIT_ECALL, "RV%d %s: stopped on %s", xlen, tier, cpu_exit_name(reason));
+            CHECK(function == expected, "RV%d %s: rewritten function returned %u in all, expected %u",
+                  xlen, tier, function, expected);
+            CHECK(crossing == expected, "RV%d %s: rewritten page-crossing function returned %u in all, "
+                  "expected %u", xlen, tier, crossing, expected);
+            memory_destroy(&memory);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#include "test.h"
+
+// minstret across a CSR access that raises illegal instruction from a hot
+// loop. The trap handler skips the access, which does not retire, so the
+// count read at the end is the same on every tier, however the loop was run
+// when it trapped: interpreted, from a predecoded block, or as the last op
+// of a translated one.
+
+#define RESULT 0x5000
+#define OUTER 8
+#define INNER 64
+#define CSR_MISSING 0x7C0   // Custom M-mode read/write number this core leaves out
+
+// Instructions retired up to the minstret read: 5 of setup, then per outer
+// iteration the 2-op li and a jal, 7 per inner trip (addi, the handler's 4, addi, bne;
+// the faulting csrr does not retire) and the outer addi and bne
+#define EXPECTED (5 + OUTER * (3 + INNER * (1 + 4 + 2) + 2))
+
+static void build(program_t* p) {
+    p->n = 0;
+    emit(p, AUIPC(T0, 0));
+    uint32_t handler_auipc = p->n - 1;
+    uint32_t handler_addi = emit(p, 0);
+    emit(p, CSRRW(ZERO, CSR_MTVEC, T0));
+    emit_li(p, S2, OUTER);
+
+    // The outer loop is never hot enough to translate: its blocks run
+    // predecoded between the inner loop's translated ones
+    uint32_t outer = p->n;
+    emit_li(p, S3, INNER);
+    emit(p, JAL(ZERO, 4));
+    uint32_t inner = p->n;
+    emit(p, ADDI(A2, A2, 1));
+    emit(p, CSRRS(A0, CSR_MISSING, ZERO));
+    emit(p, ADDI(S3, S3, -1));
+    emit(p, BNE(S3, ZERO, TO(p, inner)));
+    emit(p, ADDI(S2, S2, -1));
+    emit(p, BNE(S2, ZERO, TO(p, outer)));
+
+    emit(p, CSRRS(A1, CSR_MINSTRET, ZERO));
+    emit_li(p, T0, RESULT);
+    emit(p, SW(A1, T0, 0));
+    emit(p, SW(A2, T0, 4));
+    emit(p, CSRRW(ZERO, CSR_MTVEC, ZERO));  // ecall stops the run
+    emit(p, ECALL);
+
+    // Trap handler: step over the faulting instruction
+    uint32_t handler = p->n;
+    emit(p, CSRRS(T1, CSR_MEPC, ZERO));
+    emit(p, ADDI(T1, T1, 4));
+    emit(p, CSRRW(ZERO, CSR_MEPC, T1));
+    emit(p, MRET);
+    p->code[handler_addi] = ADDI(T0, T0, (int32_t)(handler - handler_auipc) * 4);
+}
+
+void test_csr(void) {
+    static program_t program;
+    build(&program);
+    for (int xlen = 32; xlen <= 64; xlen += 32) {
+        const machine_core_t* core = machine_core(xlen);
+        for (int t = 0; t < test_tier_count; t++) {
+            memory_t memory;
+            cpu_exit_t reason = test_run(core, test_tiers[t].config, &program, &memory, 1000000);
+            const char* tier = test_tiers[t].name;
+            uint32_t minstret = memory_read_word(&memory, TEST_RAM_BASE + RESULT);
+            uint32_t trips = memory_read_word(&memory, TEST_RAM_BASE + RESULT + 4);
+            CHECK(reason == CPU_EXIT_ECALL, "RV%d %s: stopped on %s", xlen, tier, cpu_exit_name(reason));
+            CHECK(trips == OUTER * INNER, "RV%d %s: inner loop ran %u times", xlen, tier, trips);
+            CHECK(minstret == EXPECTED, "RV%d %s: minstret %u, expected %u", xlen, tier, minstret, EXPECTED);
+            memory_destroy(&memory);
+        }
+    }
+}
@@ -0,0 +1,126 @@
+#include <string.h>
+#include <sys/mman.h>
+#include "decode.h"
+#include "icache.h"
+#include "test.h"
+
+// decode_batch() must decode every halfword slot exactly as cpu_decode()
+// does. Built once per XLEN like the core (test_decode_rv32/_rv64). Pages
+// are decoded the way icache_new_page() does it, ICACHE_SLOTS - 1 slots
+// ending at a guard page, which runs the AVX2 path (when built for it) on
+// all but the last few slots; short and unaligned counts run the scalar
+// tail on the same words.
+
+#define PAGES 64
+
+static uint32_t rng_state = 0x9E3779B9u;
+
+static uint32_t rng(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Encodings the tables treat specially, or the scalar decoder finishes
+static const uint32_t edge_words[] = {
+    0x00000013, 0x00000073, 0x00100073, 0x30200073, 0x10200073, 0x10500073,   // nop, ecall, ebreak, mret, sret, wfi
+    0x34051073, 0x340022f3, 0xc0002573, 0xb0202073, 0x7c002573,               // CSR ops, an unknown CSR
+    0x0000100f, 0x0ff0000f,                                                   // fence.i, fence
+    0x02a5f033, 0x02a5c533, 0x40b50533, 0x00b51033,                           // M, sub, sll with rd x0
+    0x02051513, 0x03f51513, 0x43f55513, 0x02055013,                           // RV64 slli/srai, shamt >= 32
+    0x4205d51b, 0x0205151b, 0x0015951b, 0x4015d51b,                           // slliw/sraiw, bad and good shamt
+    0x00a52027, 0x00a53027, 0xfea52fa7, 0x00052007, 0x00053007,               // fsw, fsd, flw, fld
+    0x00b57553, 0x08b57553, 0x10b57553, 0x58057553, 0xc0057553, 0xc0157553,   // OP-FP: fadd..fsqrt, fcvt rs2
+    0xc0257553, 0xd0057553, 0xe0050553, 0xe0051553, 0xf0050553, 0xa0b52553,   //   variants, fmv, fclass, feq
+    0x20b50553, 0x20b51553, 0x28b50553, 0x42057553, 0x40157553,               //   fsgnj, fmin, fcvt.d.s/s.d
+    0x60b5252f, 0x0eb5252f, 0x100520af, 0x1805a02f, 0x00b5302f,               // AMOs, aq/rl, lr/sc, .d
+    0x0cb5202b, 0x00a5b043, 0x00a5b047, 0x00a5b04b, 0x00a5b04f, 0x02a5b043,   // custom, FMA (.s and .d)
+    0xfff00013, 0x800002b7, 0xfffff297, 0x800000ef, 0xfe000ee3, 0xfe001ee3,   // sign-extended immediates
+    0x00000000, 0xffffffff, 0x0000ffff, 0xffff0000,                           // all-zero/all-one halves
+};
+
+// Compressed encodings, two per word: quadrant edges and x0/sp forms
+static const uint16_t edge_halves[] = {
+    0x0000, 0x0001, 0x0002, 0x4501, 0x6105, 0x6141, 0x8082, 0x9002, 0x9082,
+    0x8522, 0x852e, 0x0505, 0x1141, 0xe0a2, 0xa001, 0xc105, 0x4108, 0xc10c,
+    0x2108, 0xa10c, 0x6108, 0xe10c, 0x6000, 0x2000, 0x3002, 0xe002, 0x0082,
+};
+
+static void fill_page(uint8_t* page, uint32_t n) {
+    uint32_t* words = (uint32_t*)page;
+    for (uint32_t i = 0; i < ICACHE_PAGE_SIZE / 4; i++) {
+        uint32_t r = rng();
+        switch ((r >> 28) & 0x3) {
+            case 0:
+                words[i] = edge_words[rng() % (sizeof(edge_words) / sizeof(edge_words[0]))];
+                break;
+            case 1: {
+                uint32_t count = sizeof(edge_halves) / sizeof(edge_halves[0]);
+                words[i] = edge_halves[rng() % count] | (uint32_t)edge_halves[rng() % count] << 16;
+                break;
+            }
+            case 2:
+                words[i] = rng() | 0x3;     // Any 32-bit encoding
+                break;
+            default:
+                words[i] = rng();           // Mixed lengths, misaligned 32-bit ops
+                break;
+        }
+    }
+    // Last word: a 32-bit op filling it, or an RVC op followed by the first
+    // half of a 32-bit op that crosses the page end (left to icache_lookup())
+    words[ICACHE_PAGE_SIZE / 4 - 1] = (n & 1) ? 0x02051513 : 0xffff0001;
+}
+
+static int same(const instruction_t* a, const instruction_t* b) {
+    return a->imm == b->imm && a->inst_type == b->inst_type && a->rd == b->rd && a->rs1 == b->rs1 &&
+           a->rs2 == b->rs2 && a->rs3 == b->rs3 && a->length == b->length && a->pair == b->pair &&
+           a->variant == b->variant;
+}
+
+// Decode count slots from slot first with one decode_batch() call and
+// compare them with cpu_decode(); returns the number that differ
+static int compare(const uint8_t* page, uint32_t first, uint32_t count, const char* what) {
+    static instruction_t batch[ICACHE_SLOTS];
+    int failed = 0;
+    memset(batch, 0xA5, sizeof(batch));
+    decode_batch(page + 2 * first, count, batch);
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t word;
+        instruction_t expected;
+        memset(&expected, 0, sizeof(expected));
+        memcpy(&word, page + 2 * (first + i), 4);
+        cpu_decode(word, &expected);
+        if (!same(&expected, &batch[i]) && failed++ < 4) {
+            CHECK(0, "RV%d %s slot %u (0x%08x): type %u imm %d rd %u rs1 %u rs2 %u rs3 %u len %u, "
+                  "expected type %u imm %d rd %u rs1 %u rs2 %u rs3 %u len %u", XLEN, what, first + i, word,
+                  batch[i].inst_type, batch[i].imm, batch[i].rd, batch[i].rs1, batch[i].rs2, batch[i].rs3,
+                  batch[i].length, expected.inst_type, expected.imm, expected.rd, expected.rs1,
+                  expected.rs2, expected.rs3, expected.length);
+        }
+    }
+    if (failed > 4) CHECK(0, "RV%d %s: %d more slots differ", XLEN, what, failed - 4);
+    return failed;
+}
+
+void CORE_NAME(test_decode)(void) {
+    // A code page followed by an inaccessible one, so reading past the
+    // count * 2 + 2 bytes decode_batch() may touch faults
+    uint8_t* map = mmap(NULL, 2 * ICACHE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED || mprotect(map + ICACHE_PAGE_SIZE, ICACHE_PAGE_SIZE, PROT_NONE) != 0) {
+        CHECK(0, "cannot map the test page");
+        return;
+    }
+    decode_batch_init();
+
+    int failed = 0;
+    for (uint32_t n = 0; n < PAGES; n++) {
+        fill_page(map, n);
+        failed += compare(map, 0, ICACHE_SLOTS - 1, "page");
+        failed += compare(map, 1, 16 * (n % 8) + n % 16, "unaligned run");
+        failed += compare(map, ICACHE_SLOTS - 1 - n % 16, n % 16, "page end");
+    }
+    CHECK(failed == 0, "RV%d: %d slots differ in %d pages", XLEN, failed, PAGES);
+    munmap(map, 2 * ICACHE_PAGE_SIZE);
+}
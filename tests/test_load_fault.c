@@ -0,0 +1,122 @@
+#include "test.h"
+
+// A load into x0 still makes the access: its value is discarded, not the
+// load. S-mode loops over lw x0 from an unmapped page under Sv32/Sv39, and
+// the trap handler counts the page faults and steps over each one. The
+// handler runs in M-mode, or in S-mode with the faults delegated and no
+// mtvec installed.
+
+#define TABLES 0x10000      // Root table, then the next levels a page apart
+#define UNMAPPED 0xA000     // Past the identity-mapped pages 0-7
+#define RESULT 0x5000
+#define ITERATIONS 64
+
+#define PTE_CODE 0xCF       // V R W X A D
+#define CAUSE_LOAD_PAGE_FAULT 13
+
+#define CSR_MCAUSE  0x342
+#define CSR_MEDELEG 0x302
+#define CSR_STVEC   0x105
+#define CSR_SEPC    0x141
+#define CSR_SCAUSE  0x142
+#define SRET        0x10200073u
+
+// Store value at address (before translation is on)
+static void emit_store(program_t* p, uint32_t address, uint32_t value) {
+    emit_li(p, T0, address);
+    emit_li(p, T1, value);
+    emit(p, SW(T1, T0, 0));
+}
+
+// Page tables mapping virtual pages 0-7 to themselves, and satp in T2
+static void emit_tables(program_t* p, int xlen) {
+    uint32_t leaves = TABLES + 0x1000;
+    if (xlen == 64) {
+        emit_store(p, TABLES, ((TABLES + 0x2000) >> 12) << 10 | 1);   // Sv39: root, middle, leaves
+        emit_store(p, TABLES + 0x2000, (leaves >> 12) << 10 | 1);
+    } else {
+        emit_store(p, TABLES, (leaves >> 12) << 10 | 1);
+    }
+    for (uint32_t page = 0; page < 8; page++) {
+        emit_store(p, leaves + page * (xlen / 8), page << 10 | PTE_CODE);
+    }
+    if (xlen == 64) {
+        emit(p, ADDI(T2, ZERO, 8));
+        emit(p, SLLI(T2, T2, 60));
+        emit(p, ADDI(T2, T2, TABLES >> 12));
+    } else {
+        emit_li(p, T2, 0x80000000u | TABLES >> 12);
+    }
+}
+
+static void build(program_t* p, int xlen, int delegate) {
+    p->n = 0;
+    emit(p, AUIPC(T0, 0));
+    uint32_t handler_auipc = p->n - 1;
+    uint32_t handler_addi = emit(p, 0);
+    if (delegate) {
+        emit(p, CSRRW(ZERO, CSR_STVEC, T0));
+        emit_li(p, T0, 1 << CAUSE_LOAD_PAGE_FAULT);
+        emit(p, CSRRW(ZERO, CSR_MEDELEG, T0));
+    } else {
+        emit(p, CSRRW(ZERO, CSR_MTVEC, T0));
+    }
+    emit_tables(p, xlen);
+    emit(p, CSRRW(ZERO, CSR_SATP, T2));
+    emit_li(p, T0, 0x800);              // mstatus.MPP = S
+    emit(p, CSRRW(ZERO, CSR_MSTATUS, T0));
+    emit(p, AUIPC(T0, 0));
+    emit(p, ADDI(T0, T0, 16));
+    emit(p, CSRRW(ZERO, CSR_MEPC, T0));
+    emit(p, MRET);
+
+    // S-mode
+    emit_li(p, A0, UNMAPPED);
+    emit_li(p, S2, ITERATIONS);
+    emit(p, ADDI(S1, ZERO, 0));
+    uint32_t loop = p->n;
+    emit(p, LW(ZERO, A0, 0));
+    emit(p, ADDI(S2, S2, -1));
+    emit(p, BNE(S2, ZERO, TO(p, loop)));
+    emit_li(p, T0, RESULT);
+    emit(p, SW(S1, T0, 0));
+    emit(p, ECALL);
+
+    // Trap handler: count load page faults and step over them; anything
+    // else (the ecall above) ends the run
+    uint32_t handler = p->n;
+    uint32_t epc = delegate ? CSR_SEPC : CSR_MEPC;
+    emit(p, CSRRS(T1, delegate ? CSR_SCAUSE : CSR_MCAUSE, ZERO));
+    emit(p, ADDI(T2, ZERO, CAUSE_LOAD_PAGE_FAULT));
+    emit(p, BNE(T1, T2, 24));
+    emit(p, ADDI(S1, S1, 1));
+    emit(p, CSRRS(T1, epc, ZERO));
+    emit(p, ADDI(T1, T1, 4));
+    emit(p, CSRRW(ZERO, epc, T1));
+    emit(p, delegate ? SRET : MRET);
+    if (!delegate) emit(p, CSRRW(ZERO, CSR_MTVEC, ZERO));  // ecall stops the run
+    emit(p, ECALL);
+    p->code[handler_addi] = ADDI(T0, T0, (int32_t)(handler - handler_auipc) * 4);
+}
+
+void test_load_fault(void) {
+    static program_t program;
+    for (int xlen = 32; xlen <= 64; xlen += 32) {
+        const machine_core_t* core = machine_core(xlen);
+        for (int delegate = 0; delegate <= 1; delegate++) {
+            const char* mode = delegate ? "S-mode handler" : "M-mode handler";
+            build(&program, xlen, delegate);
+            for (int t = 0; t < test_tier_count; t++) {
+                memory_t memory;
+                cpu_exit_t reason = test_run(core, test_tiers[t].config, &program, &memory, 1000000);
+                const char* tier = test_tiers[t].name;
+                uint32_t faults = memory_read_word(&memory, TEST_RAM_BASE + RESULT);
+                CHECK(reason == CPU_EXIT_ECALL, "RV%d %s, %s: stopped on %s", xlen, tier, mode,
+                      cpu_exit_name(reason));
+                CHECK(faults == ITERATIONS, "RV%d %s, %s: lw x0 took %u page faults, expected %u",
+                      xlen, tier, mode, faults, ITERATIONS);
+                memory_destroy(&memory);
+            }
+        }
+    }
+}
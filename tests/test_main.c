@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+
+// Test runner: links the core for both widths, like the emulator, and runs
+// guest programs built in memory through machine_core(). With no arguments
+// every suite runs; otherwise the named ones (ctest runs one per test).
+
+int test_failures = 0;
+
+const test_tier_t test_tiers[] = {
+    { "interpreter", { .fusion = 1, .jit = 0, .warm_threshold = UINT32_MAX, .hot_threshold = UINT32_MAX } },
+    { "blocks",      { .fusion = 1, .jit = 0, .warm_threshold = 0, .hot_threshold = UINT32_MAX } },
+    { "blocks -F",   { .fusion = 0, .jit = 0, .warm_threshold = 0, .hot_threshold = UINT32_MAX } },
+    { "jit",         { .fusion = 1, .jit = 1, .warm_threshold = 0, .hot_threshold = 0 } },
+    { "jit -F",      { .fusion = 0, .jit = 1, .warm_threshold = 0, .hot_threshold = 0 } },
+    { "default",     { .fusion = 1, .jit = 1, .warm_threshold = CPU_WARM_THRESHOLD, .hot_threshold = CPU_HOT_THRESHOLD } },
+};
+const int test_tier_count = sizeof(test_tiers) / sizeof(test_tiers[0]);
+
+void (*test_attach)(memory_t* memory) = NULL;
+
+cpu_exit_t test_run(const machine_core_t* core, machine_config_t config, const program_t* p,
+                    memory_t* memory, uint64_t max_instructions) {
+    if (memory_init(memory, TEST_RAM_BASE, TEST_RAM_SIZE, 0) != 0) {
+        printf("  cannot map guest RAM\n");
+        return CPU_EXIT_FETCH_FAULT;
+    }
+    if (test_attach) test_attach(memory);
+    for (uint32_t i = 0; i < p->n; i++) {
+        memory_write_word(memory, TEST_RAM_BASE + i * 4, p->code[i]);
+    }
+    config.entry = TEST_RAM_BASE;
+    void* cpu = core->create(&config);
+    if (!cpu) return CPU_EXIT_FETCH_FAULT;
+    cpu_exit_t reason = core->run(cpu, memory, max_instructions);
+    core->destroy(cpu);
+    return reason;
+}
+
+void test_x0(void);
+void test_decode_rv32(void);
+void test_decode_rv64(void);
+void test_code_write(void);
+void test_csr(void);
+void test_load_fault(void);
+
+static const struct {
+    const char* name;
+    void (*run)(void);
+} suites[] = {
+    { "x0", test_x0 },
+    { "decode_rv32", test_decode_rv32 },
+    { "decode_rv64", test_decode_rv64 },
+    { "code_write", test_code_write },
+    { "csr", test_csr },
+    { "load_fault", test_load_fault },
+};
+
+static int run_suite(int i) {
+    int before = test_failures;
+    printf("%s\n", suites[i].name);
+    suites[i].run();
+    int failed = test_failures - before;
+    printf("%s: %s\n", suites[i].name, failed ? "FAILED" : "ok");
+    return failed;
+}
+
+int main(int argc, char** argv) {
+    int count = sizeof(suites) / sizeof(suites[0]);
+    printf("Block tier: %s core%s\n", THREADED_CODE ? "threaded" : "jump table", JIT_CODE ? ", x86-64 JIT" : "");
+    if (argc < 2) {
+        for (int i = 0; i < count; i++) run_suite(i);
+        return test_failures != 0;
+    }
+    for (int a = 1; a < argc; a++) {
+        int found = 0;
+        for (int i = 0; i < count; i++) {
+            if (strcmp(argv[a], suites[i].name) == 0) {
+                run_suite(i);
+                found = 1;
+            }
+        }
+        if (!found) {
+            printf("Unknown suite %s\n", argv[a]);
+            return 2;
+        }
+    }
+    return test_failures != 0;
+}
@@ -0,0 +1,250 @@
+#include "test.h"
+
+// Writes to x0 must be dropped on every tier. The decoder sends them to a
+// sink register (REG_SINK) that the handlers, fused pairs and JIT write
+// freely, so this runs one instruction of each class with rd = x0 in a hot
+// loop and ORs x0 into an accumulator after every one. The loop ends with
+// addi+bne, which fuses, and every tier runs it with and without fusion.
+// Loads into x0 are still made. Outside RAM they reach a device counting
+// its reads or, in sandboxed builds (which have no MMIO), take access faults
+// the handler steps over; either way every one must show.
+
+#define DATA 0x8000     // Scratch words the loads, LR/SC and AMOs use
+#define DEVICE 0x200000 // Past the end of guest RAM: all-ones reads, or faults
+#define ITERATIONS 64
+
+// Result words at DATA
+#define ACCUMULATOR 0x40    // OR of x0 after every write, must stay 0
+#define STORED_ZERO 0x44    // -1 overwritten by sw x0
+#define SC_WORD     0x08    // sc.w stores a0 (5)
+#define AMO_WORD    0x10    // amoadd.w adds a1 (3) each iteration
+#define SWAP_WORD   0x18    // amoswap.w stores a0
+#define AMO_DWORD   0x20    // amoadd.d adds a1 (RV64)
+#define FAULTS      0x48    // Sum of the trap causes taken, 0 unless sandboxed
+
+#define CAUSE_LOAD_ACCESS 5
+#define CSR_MCAUSE 0x342
+
+static uint32_t device_reads;
+
+static uint64_t device_read(void* ctx, uint64_t offset, uint32_t size) {
+    (void)ctx; (void)offset; (void)size;
+    device_reads++;
+    return ~0ull;
+}
+
+static void attach_device(memory_t* memory) {
+    if (!MEMORY_SANDBOX) memory_add_mmio(memory, DEVICE, MEMORY_PAGE_SIZE, device_read, NULL, NULL);
+}
+
+static void emit_check(program_t* p) {
+    emit(p, OR(S1, S1, ZERO));
+}
+
+static void build(program_t* p, int xlen) {
+    p->n = 0;
+    emit(p, AUIPC(T0, 0));
+    uint32_t handler_auipc = p->n - 1;
+    uint32_t handler_addi = emit(p, 0);
+    emit(p, CSRRW(ZERO, CSR_MTVEC, T0));
+    emit(p, ADDI(A3, ZERO, 0));
+    emit_li(p, S3, DEVICE);
+    emit_li(p, S0, DATA);
+    emit_li(p, S2, ITERATIONS);
+    emit(p, ADDI(S1, ZERO, 0));
+    emit(p, ADDI(A0, ZERO, 5));
+    emit(p, ADDI(A1, ZERO, 3));
+    emit(p, ADDI(T0, ZERO, -1));
+    emit(p, SW(T0, S0, 0));
+    emit(p, SW(T0, S0, 4));
+    emit(p, SW(T0, S0, STORED_ZERO));
+    emit(p, FMV_W_X(1, A0));
+
+    uint32_t loop = p->n;
+    // ALU and M
+    uint32_t alu[] = {
+        ADD(ZERO, A0, A1), SUB(ZERO, A0, A1), OR(ZERO, A0, A1), SLTU(ZERO, A1, A0),
+        ADDI(ZERO, A0, 7), SLTI(ZERO, A1, 9), XORI(ZERO, A0, -1), SLLI(ZERO, A0, 3),
+        SRAI(ZERO, T0, 1), MUL(ZERO, A0, A1), MULHU(ZERO, T0, T0), DIV(ZERO, A0, A1),
+        REMU(ZERO, A0, A1),
+    };
+    for (uint32_t i = 0; i < sizeof(alu) / sizeof(alu[0]); i++) {
+        emit(p, alu[i]);
+        emit_check(p);
+    }
+    if (xlen == 64) {
+        emit(p, ADDIW(ZERO, A0, 1));
+        emit_check(p);
+        emit(p, ADDW(ZERO, A0, A1));
+        emit_check(p);
+        emit(p, MULW(ZERO, A0, A1));
+        emit_check(p);
+    }
+    // x0 as a branch operand right after a write, unfused (first op writes x0)
+    emit(p, ADDI(ZERO, A0, 1));
+    emit(p, BNE(ZERO, ZERO, 0));    // patched below to fail
+    uint32_t bne_fail = p->n - 1;
+
+    // Loads of all-ones words
+    emit(p, LW(ZERO, S0, 0));
+    emit_check(p);
+    emit(p, LBU(ZERO, S0, 4));
+    emit_check(p);
+    if (xlen == 64) {
+        emit(p, LD(ZERO, S0, 0));
+        emit_check(p);
+    }
+    emit(p, LW(ZERO, S3, 0));
+    emit_check(p);
+    emit(p, LBU(ZERO, S3, 1));
+    emit_check(p);
+    if (xlen == 64) {
+        emit(p, LD(ZERO, S3, 8));
+        emit_check(p);
+    }
+
+    // Upper immediates
+    emit(p, LUI(ZERO, 0x12345));
+    emit_check(p);
+    emit(p, AUIPC(ZERO, 1));
+    emit_check(p);
+
+    // Jumps: each skips an addi that would poison the accumulator
+    emit(p, JAL(ZERO, 8));
+    emit(p, ADDI(S1, S1, 1));
+    emit_check(p);
+    emit(p, AUIPC(T2, 0));
+    emit(p, JALR(ZERO, T2, 12));
+    emit(p, ADDI(S1, S1, 1));
+    emit_check(p);
+
+    // CSR reads into x0, with and without a write
+    emit(p, CSRRW(ZERO, CSR_MSCRATCH, A0));
+    emit_check(p);
+    emit(p, CSRRS(ZERO, CSR_MSCRATCH, A1));
+    emit_check(p);
+    emit(p, CSRRWI(ZERO, CSR_MSCRATCH, 9));
+    emit_check(p);
+    emit(p, CSRRCI(ZERO, CSR_MSCRATCH, 1));
+    emit_check(p);
+    emit(p, CSRRS(ZERO, CSR_MINSTRET, ZERO));
+    emit_check(p);
+
+    // LR/SC and AMOs
+    emit(p, ADDI(T1, S0, SC_WORD));
+    emit(p, LR_W(ZERO, T1));
+    emit_check(p);
+    emit(p, SC_W(ZERO, A0, T1));
+    emit_check(p);
+    emit(p, ADDI(T1, S0, AMO_WORD));
+    emit(p, AMOADD_W(ZERO, A1, T1));
+    emit_check(p);
+    emit(p, ADDI(T1, S0, SWAP_WORD));
+    emit(p, AMOSWAP_W(ZERO, A0, T1));
+    emit_check(p);
+    if (xlen == 64) {
+        emit(p, ADDI(T1, S0, AMO_DWORD));
+        emit(p, AMOADD_D(ZERO, A1, T1));
+        emit_check(p);
+    }
+
+    // Floating point to integer
+    emit(p, FMV_X_W(ZERO, 1));
+    emit_check(p);
+    emit(p, FEQ_S(ZERO, 1, 1));
+    emit_check(p);
+    emit(p, FCVT_W_S(ZERO, 1));
+    emit_check(p);
+
+    // Fused pairs whose second op writes x0: auipc+lw, auipc+ld, slli+add
+    // and auipc+jalr (which ends the block, like the jumps above)
+    emit(p, AUIPC(T0, 0));
+    emit(p, LW(ZERO, T0, 0));
+    emit_check(p);
+    if (xlen == 64) {
+        emit(p, AUIPC(T0, 0));
+        emit(p, LD(ZERO, T0, 0));
+        emit_check(p);
+    }
+    emit(p, SLLI(T1, A0, 2));
+    emit(p, ADD(ZERO, T1, A1));
+    emit_check(p);
+    emit(p, AUIPC(T0, 0));
+    emit(p, JALR(ZERO, T0, 12));
+    emit(p, ADDI(S1, S1, 1));
+    emit_check(p);
+
+    emit(p, ADDI(S2, S2, -1));
+    emit(p, BNE(S2, ZERO, TO(p, loop)));
+
+    // Results
+    emit(p, SW(S1, S0, ACCUMULATOR));
+    emit(p, SW(ZERO, S0, STORED_ZERO));
+    emit(p, SW(A3, S0, FAULTS));
+    emit(p, CSRRW(ZERO, CSR_MTVEC, ZERO));  // ecall stops the run
+    emit(p, ECALL);
+
+    // Taken only if x0 read back nonzero: leave a marker and stop
+    uint32_t fail = p->n;
+    emit(p, ADDI(S1, ZERO, 0x7FF));
+    emit(p, SW(S1, S0, ACCUMULATOR));
+    emit(p, CSRRW(ZERO, CSR_MTVEC, ZERO));
+    emit(p, ECALL);
+    p->code[bne_fail] = BNE(ZERO, ZERO, (int32_t)(fail - bne_fail) * 4);
+
+    // Trap handler: add up the causes and step over the faulting load
+    uint32_t handler = p->n;
+    emit(p, CSRRS(A4, CSR_MCAUSE, ZERO));
+    emit(p, ADD(A3, A3, A4));
+    emit(p, CSRRS(A4, CSR_MEPC, ZERO));
+    emit(p, ADDI(A4, A4, 4));
+    emit(p, CSRRW(ZERO, CSR_MEPC, A4));
+    emit(p, MRET);
+    p->code[handler_addi] = ADDI(T0, T0, (int32_t)(handler - handler_auipc) * 4);
+}
+
+static uint32_t data_word(memory_t* memory, uint32_t offset) {
+    return memory_read_word(memory, TEST_RAM_BASE + DATA + offset);
+}
+
+void test_x0(void) {
+    static program_t program;
+    test_attach = attach_device;
+    for (int xlen = 32; xlen <= 64; xlen += 32) {
+        const machine_core_t* core = machine_core(xlen);
+        build(&program, xlen);
+        for (int t = 0; t < test_tier_count; t++) {
+            memory_t memory;
+            device_reads = 0;
+            cpu_exit_t reason = test_run(core, test_tiers[t].config, &program, &memory, 1000000);
+            const char* tier = test_tiers[t].name;
+            CHECK(reason == CPU_EXIT_ECALL, "RV%d %s: stopped on %s", xlen, tier, cpu_exit_name(reason));
+            CHECK(data_word(&memory, ACCUMULATOR) == 0, "RV%d %s: x0 read back 0x%x",
+                  xlen, tier, data_word(&memory, ACCUMULATOR));
+            CHECK(data_word(&memory, STORED_ZERO) == 0, "RV%d %s: sw x0 stored 0x%x",
+                  xlen, tier, data_word(&memory, STORED_ZERO));
+            CHECK(data_word(&memory, SC_WORD) == 5, "RV%d %s: sc.w stored 0x%x",
+                  xlen, tier, data_word(&memory, SC_WORD));
+            CHECK(data_word(&memory, AMO_WORD) == 3 * ITERATIONS, "RV%d %s: amoadd.w left %u",
+                  xlen, tier, data_word(&memory, AMO_WORD));
+            CHECK(data_word(&memory, SWAP_WORD) == 5, "RV%d %s: amoswap.w stored 0x%x",
+                  xlen, tier, data_word(&memory, SWAP_WORD));
+            if (xlen == 64) {
+                CHECK(data_word(&memory, AMO_DWORD) == 3 * ITERATIONS, "RV64 %s: amoadd.d left %u",
+                      tier, data_word(&memory, AMO_DWORD));
+            }
+            uint32_t loads = (xlen == 64 ? 3 : 2) * ITERATIONS;
+            if (MEMORY_SANDBOX) {
+                CHECK(data_word(&memory, FAULTS) == CAUSE_LOAD_ACCESS * loads,
+                      "RV%d %s: loads into x0 outside RAM took causes adding up to %u, expected %u "
+                      "access faults", xlen, tier, data_word(&memory, FAULTS), loads);
+            } else {
+                CHECK(device_reads == loads && data_word(&memory, FAULTS) == 0,
+                      "RV%d %s: loads into x0 read the device %u times, expected %u", xlen, tier,
+                      device_reads, loads);
+            }
+            memory_destroy(&memory);
+        }
+    }
+    test_attach = NULL;
+}